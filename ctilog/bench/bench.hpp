@@ -0,0 +1,57 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file bench/bench.hpp
+ * Helpers of micro benchmarks, built with -DCTILOG_BUILD_BENCH=ON
+ */
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+namespace cti {
+namespace log
+{
+namespace bench
+{
+/// Runs of each case, best one reported
+constexpr int kRuns = 5;
+/// Keeps results alive, so calls are not optimized away
+static volatile uint64_t kSink = 0;
+/**
+ * Call @a f @a n times in each of kRuns runs
+ * @return best ns per call
+ */
+template<typename F>
+double Measure(uint64_t const n, F&& f) noexcept
+{
+    double best = 1e18;
+    for (int r = 0; r < kRuns; ++r) {
+        auto const t0 = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < n; ++i) {
+            f(i);
+        }
+        double const ns = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - t0).count();
+        best = std::min(best, ns / double(n));
+    }
+    return best;
+}
+/// Print one result line
+inline void Report(char const* const name, double const ns) noexcept
+{
+    ::printf("%-40s %10.1f ns\n", name, ns);
+}
+}//namespace bench
+}//namespace log
+}//namespace cti
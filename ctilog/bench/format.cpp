@@ -0,0 +1,93 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file bench/format.cpp
+ * Per number cost of FormatI64/FormatDouble/FormatFloat against
+ * std::to_string and std::ostream <<, a new std::ostringstream per record
+ * (as the stream macros) and one reused
+ *
+ * std::to_string(double) is %f, 6 decimals, not shortest and not read back
+ * to the same value; it is listed as the cheapest libstdc++ path only.
+ */
+#include <stdint.h>
+#include <sstream>
+#include <string>
+#include "ctilog/log/format.hpp"
+#include "bench.hpp"
+using namespace cti::log;
+using namespace cti::log::bench;
+/// Sequence numbers and counts, spread over all digit lengths
+static inline int64_t IntAt(uint64_t const i) noexcept
+{
+    return int64_t((i * 2654435761u) >> (i % 48));
+}
+/// Poses and velocities
+static inline double DoubleAt(uint64_t const i) noexcept
+{
+    return double(int64_t(i % 200000) - 100000) * 0.001 + 0.1234567;
+}
+int main()
+{
+    constexpr uint64_t kCalls = 1000000;
+    std::ostringstream reused;
+    Report("int: std::to_string", Measure(kCalls, [](uint64_t const i) {
+        kSink += std::to_string(IntAt(i)).size(); }));
+    Report("int: new std::ostringstream <<", Measure(kCalls,
+        [](uint64_t const i) {
+            std::ostringstream ss;
+            ss << IntAt(i);
+            kSink += ss.str().size();
+        }));
+    Report("int: reused std::ostringstream <<", Measure(kCalls,
+        [&reused](uint64_t const i) {
+            reused.str(std::string());
+            reused << IntAt(i);
+            kSink += uint64_t(reused.tellp());
+        }));
+    Report("int: FormatI64", Measure(kCalls, [](uint64_t const i) {
+        char buf[kFormatIntMaxLen];
+        kSink += FormatI64(buf, IntAt(i));
+    }));
+    Report("double: std::to_string (%f)", Measure(kCalls,
+        [](uint64_t const i) {
+            kSink += std::to_string(DoubleAt(i)).size(); }));
+    Report("double: new std::ostringstream <<", Measure(kCalls,
+        [](uint64_t const i) {
+            std::ostringstream ss;
+            ss << DoubleAt(i);
+            kSink += ss.str().size();
+        }));
+    Report("double: reused std::ostringstream <<", Measure(kCalls,
+        [&reused](uint64_t const i) {
+            reused.str(std::string());
+            reused << DoubleAt(i);
+            kSink += uint64_t(reused.tellp());
+        }));
+    Report("double: FormatDouble (shortest)", Measure(kCalls,
+        [](uint64_t const i) {
+            char buf[kFormatFloatMaxLen];
+            kSink += FormatDouble(buf, DoubleAt(i));
+        }));
+    Report("float: new std::ostringstream <<", Measure(kCalls,
+        [](uint64_t const i) {
+            std::ostringstream ss;
+            ss << float(DoubleAt(i));
+            kSink += ss.str().size();
+        }));
+    Report("float: FormatFloat (shortest)", Measure(kCalls,
+        [](uint64_t const i) {
+            char buf[kFormatFloatMaxLen];
+            kSink += FormatFloat(buf, float(DoubleAt(i)));
+        }));
+    return 0;
+}
@@ -0,0 +1,77 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file bench/timestamp.cpp
+ * Per call cost of the record timestamp: LogRealTime before the per second
+ * prefix cache (localtime_r and snprintf each call) against LogRealTime and
+ * FormatLogRealTime now
+ */
+#include <string.h>
+#include <time.h>
+#include <string>
+#include "ctilog/log.hpp"
+#include "bench.hpp"
+using namespace cti::log;
+using namespace cti::log::bench;
+/// LogRealTime as it was before the cache
+static std::string UncachedLogRealTime(timespec const& tp) noexcept
+{
+    struct tm localctm;
+    if (!::localtime_r(&tp.tv_sec, &localctm)) {
+        ::memset(&localctm, 0, sizeof(struct tm));
+    }
+    if (0 == localctm.tm_mday) {
+        localctm.tm_mday = 1;
+    }
+    int const tz = int(int64_t(localctm.tm_gmtoff / 3600.0));
+    char buf[kLogRealTimeMaxLen];
+    int const n = ::snprintf(buf, sizeof(buf),
+        "%02d %04d-%02d-%02d %02d:%02d:%02d.%09ld",
+        tz & 0xff, localctm.tm_year + 1900, localctm.tm_mon + 1,
+        localctm.tm_mday, localctm.tm_hour, localctm.tm_min, localctm.tm_sec,
+        long(tp.tv_nsec));
+    if (n < 0 || size_t(n) >= sizeof(buf)) {
+        return std::string();
+    }
+    return std::string(buf, size_t(n));
+}
+int main()
+{
+    constexpr uint64_t kCalls = 2000000;
+    timespec tp;
+    ::clock_gettime(CLOCK_REALTIME_COARSE, &tp);
+    // Same second as a busy logger sees, nanoseconds vary
+    auto const at = [&tp](uint64_t const i) {
+        timespec t = tp;
+        t.tv_nsec = long(i % 1000000000);
+        return t;
+    };
+    Report("before: LogRealTime(tp), no cache", Measure(kCalls,
+        [&at](uint64_t const i) {
+            kSink += UncachedLogRealTime(at(i)).size(); }));
+    Report("after: LogRealTime(tp)", Measure(kCalls,
+        [&at](uint64_t const i) { kSink += LogRealTime(at(i)).size(); }));
+    Report("after: FormatLogRealTime(tp, buf)", Measure(kCalls,
+        [&at](uint64_t const i) {
+            char buf[kLogRealTimeMaxLen];
+            kSink += FormatLogRealTime(at(i), buf);
+        }));
+    Report("after: clock_gettime + FormatLogRealTime", Measure(kCalls,
+        [](uint64_t) {
+            timespec now;
+            ::clock_gettime(CLOCK_REALTIME_COARSE, &now);
+            char buf[kLogRealTimeMaxLen];
+            kSink += FormatLogRealTime(now, buf);
+        }));
+    return 0;
+}
@@ -0,0 +1,106 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file bench/uring.cpp
+ * File output by io_uring (Logger::startUring) against stdio fwrite, with
+ * 1, 4 and 16 producer threads: ns per record including the final flush,
+ * and the worst single call a producer saw
+ *
+ * Usage: ctilog-bench-uring [log path], default in working directory; put
+ * it on the disk to measure, tmpfs hides the write(2) cost.
+ */
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ctilog/log.hpp"
+#include "bench.hpp"
+using namespace cti::log;
+using namespace cti::log::bench;
+/// Records of each run, split among producers
+constexpr int kRecords = 800000;
+/// Producer threads of each case
+constexpr int kThreads[] = { 1, 4, 16 };
+static inline uint64_t NowNs() noexcept
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+int main(int argc, char** argv)
+{
+    std::string const path = argc > 1 ? argv[1] : "ctilog-bench-uring.log";
+    auto& logger = Logger::getLogger(path, Logger::Output::File);
+    // One file through a run, no rotation
+    logger.setMaxSize(1u << 30);
+    // Cleared when kernel has no io_uring, fwrite rows still reported
+    bool hasUring = true;
+    for (int const threads: kThreads) {
+        for (bool const uring: { false, true }) {
+            if (uring && !hasUring) {
+                continue;
+            }
+            double best = 1e18;
+            std::atomic<uint64_t> worst(0);
+            for (int r = 0; r < kRuns; ++r) {
+                logger.reset(true);
+                if (uring) {
+                    int const ret = logger.startUring();
+                    if (ret < 0) {
+                        ::printf("startUring: %d, no io_uring here, "
+                            "io_uring rows skipped\n", ret);
+                        hasUring = false;
+                        break;
+                    }
+                }
+                uint64_t const t0 = NowNs();
+                std::vector<std::thread> producers;
+                for (int t = 0; t < threads; ++t) {
+                    producers.emplace_back([&logger, threads, &worst] {
+                        uint64_t most = 0;
+                        for (int i = 0; i < kRecords / threads; ++i) {
+                            uint64_t const t1 = NowNs();
+                            logger.n("name",
+                                "a message of moderate length 1234567890");
+                            most = std::max(most, NowNs() - t1);
+                        }
+                        uint64_t w = worst.load();
+                        while (most > w &&
+                            !worst.compare_exchange_weak(w, most)) {}
+                    });
+                }
+                for (auto& producer: producers) {
+                    producer.join();
+                }
+                logger.flush();
+                best = std::min(best, double(NowNs() - t0) / kRecords);
+                if (uring) {
+                    logger.stopUring();
+                }
+            }
+            if (uring && !hasUring) {
+                continue;
+            }
+            std::string const name = std::string(uring ? "io_uring" :
+                "fwrite") + ", " + std::to_string(threads) + " threads";
+            Report((name + ": per record").c_str(), best);
+            Report((name + ": worst call").c_str(), double(worst.load()));
+        }
+    }
+    logger.finish();
+    Logger::releaseLogger(path);
+    ::remove(path.c_str());
+    return 0;
+}
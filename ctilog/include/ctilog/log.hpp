@@ -13,15 +13,32 @@
 #pragma once
 #include <stdio.h>
 #include <stdint.h>
+#include <signal.h>
 #include <string>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <memory>
 #include <map>
 #include <time.h>
 #include <set>
 #include <sstream>
+#include <vector>
 #include "ctilog/loglevel.hpp"
 #include "ctilog/log/flags.hpp"
 #include "ctilog/log/scopedrwlock.hpp"
+#include "ctilog/log/boundedqueue.hpp"
+#include "ctilog/log/epoch.hpp"
+#include "ctilog/log/binary.hpp"
+#include "ctilog/log/format.hpp"
+#include "ctilog/log/logstream.hpp"
+#include "ctilog/log/stringview.hpp"
+#include "ctilog/log/callsite.hpp"
+#include "ctilog/log/flightrecorder.hpp"
+#include "ctilog/log/mmapring.hpp"
+#include "ctilog/log/uring.hpp"
+#include "ctilog/log/directwriter.hpp"
 
 #if defined __arm__ || defined __aarch64__
 #include <linux/limits.h>
@@ -34,6 +51,16 @@ constexpr char const* kPrimaryDefaultLogFile = "logger.log";
 constexpr uint32_t kMinLogSize = 8192;
 /// 256 MB / 128 MB
 constexpr uint32_t kDefaultLogSize = sizeof(long) * 32 * 1024 * 1024;
+struct LoggerHandle;
+struct LevelLogger;
+/// Default async queue records
+constexpr uint32_t kDefaultAsyncCapacity = 8192;
+/// Default flush when 8 KB not flushed
+constexpr uint32_t kDefaultFlushBytes = 8192;
+/// Default flush when oldest not flushed data older than 500 ms
+constexpr uint32_t kDefaultFlushAgeMs = 500;
+/// Default write repeat count of collapsed records at least every 10 s
+constexpr uint32_t kDefaultRepeatHoldMs = 10000;
 struct Logger {
     /// Output type
     enum Output: uint32_t {
@@ -41,10 +68,30 @@ struct Logger {
         File       = 0x2,
         Both       = 0x3,
     };
+    /// What async append does when queue full
+    enum class Backpressure: uint32_t {
+        Block,           ///< wait for backend
+        DropNewest,      ///< drop current record and count it
+        OverwriteOldest, ///< drop oldest queued record and count it
+    };
+    /// When file output is flushed, any condition hit will flush
+    struct FlushPolicy {
+        /// Flush when not flushed bytes >= bytes, 0 to flush every record
+        uint32_t bytes{ kDefaultFlushBytes };
+        /// Flush when not flushed data older than maxAgeMs, 0 no timer
+        uint32_t maxAgeMs{ kDefaultFlushAgeMs };
+        /// Flush at once when record level <= level, at least Erro
+        LogLevel level{ LogLevel::Erro };
+    };
     /// If 0 => when get logger not change current or default
     using Outputs = Flags<Output>;
     /// Callback when set when append
-    using AppendCallback = std::function<void(std::string const& name,LogLevel const& logLevel,std::string const& msg)>;
+    /**
+     * Called with name and formatted line of each record written
+     * @note name and msg only valid during the call, copy to keep them;
+     * a callback taking std::string const& still works, converted per call
+     */
+    using AppendCallback = std::function<void(StringView const& name,LogLevel const& logLevel,StringView const& msg)>;
     /// Dtor to auto finish logger
     virtual ~Logger() noexcept;
     // Global configs
@@ -53,49 +100,70 @@ struct Logger {
     static inline std::string getDefaultLogger() noexcept;
     /**
      * Get a Logger instance
-     * @param spinOnceLogLevel If not Unchange, will be use once
      * @param path Logger filename, if empty then will get a default Logger
      * @param outputs output config, used when create logger, if 0 then use
      * default or current exists
     */
     static Logger& getLogger(
-        LogLevel const& spinOnceLogLevel = LogLevel::Unchange,
+        std::string const& path = "",
+        Outputs const& outputs = Outputs{}) noexcept;
+    /**
+     * @deprecated Same as getLevel(), use it or getInfo() etc.
+     * @note Was Logger& with level used once; now the level goes with the
+     * LevelLogger returned, so getLogger(LogLevel::Erro) << x still logs at
+     * Erro, and binding it to Logger& fails to compile
+     */
+    __attribute__((deprecated("use Logger::getLevel() or getInfo() etc.")))
+    static inline LevelLogger getLogger(
+        LogLevel const& logLevel,
+        std::string const& path = "",
+        Outputs const& outputs = Outputs{}) noexcept;
+    /**
+     * Get a Logger with fixed @a logLevel, see LevelLogger
+     * @note Nothing shared changed, the level goes with the returned value
+     */
+    static inline LevelLogger getLevel(
+        LogLevel const& logLevel,
         std::string const& path = "",
         Outputs const& outputs = Outputs{}) noexcept;
 
-    static inline Logger& getFatal(
+    static inline LevelLogger getFatal(
         std::string const& path = "",
         Outputs const& outputs = Outputs{}) noexcept;
 
-    static inline Logger& getError(
+    static inline LevelLogger getError(
         std::string const& path = "",
         Outputs const& outputs = Outputs{}) noexcept;
 
-    static inline Logger& getWarning(
+    static inline LevelLogger getWarning(
         std::string const& path = "",
         Outputs const& outputs = Outputs{}) noexcept;
 
-    static inline Logger& getNote(
+    static inline LevelLogger getNote(
         std::string const& path = "",
         Outputs const& outputs = Outputs{}) noexcept;
 
-    static inline Logger& getInfo(
+    static inline LevelLogger getInfo(
         std::string const& path = "",
         Outputs const& outputs = Outputs{}) noexcept;
 
-    static inline Logger& getTrace(
+    static inline LevelLogger getTrace(
         std::string const& path = "",
         Outputs const& outputs = Outputs{}) noexcept;
 
-    static inline Logger& getDebug(
+    static inline LevelLogger getDebug(
         std::string const& path = "",
         Outputs const& outputs = Outputs{}) noexcept;
 
-    static inline Logger& getDetail(
+    static inline LevelLogger getDetail(
         std::string const& path = "",
         Outputs const& outputs = Outputs{}) noexcept;
 
-    // Release a logger
+    /**
+     * Release a logger
+     * @note Destroyed when no thread in its append or loghelper macros,
+     * references got from getLogger should not be used after release
+     */
     static void releaseLogger(std::string const& file) noexcept;
     // Instance config
     void setLogLevel(LogLevel const& logLevel) noexcept;
@@ -107,22 +175,164 @@ struct Logger {
      * - If < kMinLogSize use kMinLogSize
      */
     void setMaxSize(int32_t const maxSize) noexcept;
-    inline void setOutputs(Outputs const& o) noexcept;
-    inline void setAppendCallback(AppendCallback const& ac) noexcept;
-    inline void enableIdx(bool const enable) noexcept;
-    inline void enableTid(bool const enable) noexcept;
+    /**
+     * Set rotated files to keep: path.1 ... path.generations
+     * - If 0 use 1
+     * @note Each file holds about max size / 2
+     */
+    void setGenerations(uint32_t const generations) noexcept;
+    /**
+     * Set flush policy of file output
+     * @note Stdio buffer follows bytes when file open next time
+     */
+    void setFlushPolicy(FlushPolicy const& flushPolicy) noexcept;
+    FlushPolicy getFlushPolicy() const noexcept;
+    /// Flush file output, in async mode wait queued records written first
+    void flush() noexcept;
+    /**
+     * Flush loggers whose data wait too long and shift generations of
+     * files rotated, called by timer
+     */
+    static void flushAgedLoggers(uint64_t const nowMs) noexcept;
+    /**
+     * Install SIGSEGV, SIGABRT, SIGBUS and SIGFPE handlers: each logger's
+     * stdio buffer and async queue are written to its file by write(2)
+     * only, then a raw "crash" record with backtrace, then fdatasync; the
+     * signal then goes to the handler replaced, or default action
+     * @return 0 when success, -EALREADY when installed, else -errno
+     * @note Best effort: file and binary locks are only try_locked a
+     * while (try_lock is not async-signal-safe by POSIX, but never blocks),
+     * when not taken a thread still writing may interleave, and a stdio
+     * buffer caught mid-fwrite is written torn. stdio buffer drained only
+     * with glibc (FILE fields), and only the logger's own, never stdout.
+     * O_DIRECT buffer written as seen, no truncate. Queued records have
+     * Unix time in header. Alternate signal stack (for stack overflow) is
+     * set for calling thread only.
+     */
+    static int installCrashHandlers() noexcept;
+    /// Restore the handlers replaced
+    static void uninstallCrashHandlers() noexcept;
+    /**
+     * Collapse consecutive records of same name, level and msg in file
+     * output: first written, the rest counted and written as one "last
+     * message repeated N times" line when a different record comes, file
+     * closed or rotated, or held holdMs
+     * @param holdMs 0 to disable (default)
+     * @note Records are compared by a 64 bit hash, console not collapsed
+     */
+    void setCollapseRepeats(uint32_t const holdMs = kDefaultRepeatHoldMs) noexcept;
+    void setOutputs(Outputs const& o) noexcept;
+    /// @note Old callback freed after appends running it return
+    void setAppendCallback(AppendCallback const& ac) noexcept;
+    void enableIdx(bool const enable) noexcept;
+    void enableTid(bool const enable) noexcept;
+    inline LogLevel getLogLevel() const noexcept;
     /// @note copy
     std::set<std::string> getAcNameFilters() const noexcept;
-    bool hasAcNameFilter(std::string const& acNameFilter) const noexcept;
-    bool addAcNameFilter(std::string const& acNameFilter) noexcept;
-    bool removeAcNameFilter(std::string const& acNameFilter) noexcept;
+    bool hasAcNameFilter(StringView const& acNameFilter) const noexcept;
+    bool addAcNameFilter(StringView const& acNameFilter) noexcept;
+    bool removeAcNameFilter(StringView const& acNameFilter) noexcept;
     void clearAcNameFilters() noexcept;
-    /// Limit log size
+    /**
+     * Start async mode: append only queues the record, one backend thread
+     * formats and writes
+     * @param capacity queue records, rounded up to power of 2
+     * @param backpressure what to do when queue full
+     * @return 0 when success, -EALREADY when already async else -errno
+     * @note AppendCallback will be called in backend thread
+     */
+    int startAsync(
+        uint32_t const capacity = kDefaultAsyncCapacity,
+        Backpressure const& backpressure = Backpressure::Block) noexcept;
+    inline bool isAsync() const noexcept;
+    /// Records dropped by DropNewest or OverwriteOldest
+    inline uint64_t getDropped() const noexcept;
+    /**
+     * Start binary mode: appendBinary writes format id, time and raw args to
+     * path + ".bin" without formatting, ctilog-decode renders it to text
+     * @return 0 when success else -errno
+     * @note .bin rotates when > max size / 2 and keeps .bin.1 ... .bin.N
+     * as setGenerations, AppendCallback and console not used for binary
+     * records
+     */
+    int startBinary() noexcept;
+    /// Flush and close .bin, appendBinary formats text again
+    void stopBinary() noexcept;
+    inline bool isBinary() const noexcept;
+    /**
+     * Start flight recorder: records filtered out by log level but not above
+     * @a level are kept in a ring of @a bytes in memory, not written
+     *
+     * The ring is dumped to path + ".flight" when an Erro or Fata record is
+     * written, or by dumpFlightRecorder(); each dump has only records kept
+     * since last one. Capture copies msg into a slot without lock or header
+     * formatting, but msg of macros is formatted as for an enabled level.
+     * @return 0 when success, -EALREADY when started, -ENOMEM
+     * @note appendBinary records are not kept
+     */
+    int startFlightRecorder(
+        size_t const bytes = kDefaultFlightRecorderSize,
+        LogLevel const& level = LogLevel::Deta) noexcept;
+    void stopFlightRecorder() noexcept;
+    /// @return records written to .flight, or -errno
+    int64_t dumpFlightRecorder() noexcept;
+    /**
+     * Start ring mode: file output goes to path + ".ring", a file of
+     * @a bytes preallocated and mapped, each record copied into the mapping
+     * without a syscall and the oldest overwritten, so never rotated
+     * @return 0 when success, -EALREADY when started, else -errno
+     * @note Read by ReadRing or ctilog-decode -r. Records survive a crash of
+     * the process; Fata syncs the mapping.
+     */
+    int startRing(size_t const bytes = kDefaultRingSize) noexcept;
+    /// Unmap ring, file output goes to path again
+    void stopRing() noexcept;
+    bool isRing() const noexcept;
+    /**
+     * Write file output by io_uring: lines are copied into @a buffers
+     * buffers of @a bufferBytes, a full one is submitted and the next filled
+     * while it is written, so a producer does not wait on write(2)
+     * @return 0 when success, -EALREADY when started, -ENOSYS or -EPERM when
+     * kernel has no io_uring or it is disabled (stdio kept), else -errno
+     * @note flush() and Fata wait writes done; flush policy only submits
+     */
+    int startUring(uint32_t const buffers = kDefaultUringBuffers,
+        uint32_t const bufferBytes = kDefaultUringBufferBytes) noexcept;
+    /// Wait writes done and go back to stdio
+    void stopUring() noexcept;
+    bool isUring() const noexcept;
+    /**
+     * Write file output by O_DIRECT in blocks of @a bufferBytes, so bulk
+     * logging does not fill page cache
+     * @return 0 when success, -EALREADY when started, -EBUSY when io_uring
+     * used, -EINVAL when file system has no O_DIRECT (stdio kept), else
+     * -errno
+     * @note Flush policy bytes not used, a full buffer is written; age, level,
+     * flush() and closing write the last block padded then truncate it off.
+     * Use with startAsync() so a producer does not wait the disk
+     */
+    int startDirect(uint32_t const bufferBytes = kDefaultDirectBufferBytes)
+        noexcept;
+    /// Write the rest and go back to stdio
+    void stopDirect() noexcept;
+    bool isDirect() const noexcept;
+    /**
+     * Append a record of callsite @a format, see ctilog/log/binary.hpp
+     * @note Formatted at once and appended as text when not binary mode
+     */
+    template<typename... Args>
+    int appendBinary(BinaryFormat const& format, Args const&... args) noexcept;
+    /// Limit log size, rotate by rename when live file > max size / 2
     void shrinkToFit() noexcept;
     /// Check if log instance valid
     inline operator bool() const noexcept;
-    /// @note Only check log level
+    /**
+     * @note Only check log level, true too for a level kept by flight
+     * recorder
+     */
     inline bool isLogable(LogLevel const& ll) const noexcept;
+    /// Log level or flight recorder level, whichever higher
+    inline LogLevel getAcceptLevel() const noexcept;
     /**
      * Rereset logger file
      * @note
@@ -130,161 +340,263 @@ struct Logger {
      * - When param invalid => will use default or not-reopen
      */
     int64_t reset(bool const trunc = false) noexcept;
-    /// Append name + file + line + msg
+    /**
+     * Append name + file + line + msg, no copy made
+     * @param name nullptr data for none
+     * @note A literal, char const* or std::string converts to StringView
+     */
     int append(
-        char const* const name,
+        StringView const& name,
         char const* const file,
         int const line,
-        std::string const& msg,
+        StringView const& msg,
         LogLevel const& logLevel) noexcept;
-    /// Append a string msg
-    int append(std::string const& msg, LogLevel const& logLevel) noexcept;
-    // Logging methods
-    template<typename T = std::string>
-    typename std::enable_if<std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& f(T const& msg)
-        noexcept;
-    template<typename T = std::string>
-    typename std::enable_if<std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& f(
-        std::string const& name, T const& msg) noexcept;
+    /// Append msg as raw record, no copy made
+    int append(StringView const& msg, LogLevel const& logLevel) noexcept;
+    /**
+     * Append msg of a loghelper macro, name, level and cached " (file+line)"
+     * taken from @a site
+     */
+    int append(Callsite const& site, StringView const& msg) noexcept;
+    /**
+     * Append msg of "{}" format @a fmt, see ctilog/log/format.hpp
+     * @note Args formatted into a per-thread buffer only when level passes.
+     * @a fmt is a literal, checked at compile time by loghelper LogFmt, or
+     * here when compiled as C++20 (see FormatString); else RuntimeFormat(s)
+     * for a format made at run time, never checked
+     */
+    template<typename... Args>
+    int format(
+        LogLevel const& logLevel,
+        StringView const& name,
+        char const* const file,
+        int const line,
+        FormatString<sizeof...(Args)> const fmt,
+        Args const&... args) noexcept;
+    /// format of a loghelper LogFmt callsite
+    template<typename... Args>
+    int format(Callsite const& site, FormatString<sizeof...(Args)> const fmt,
+        Args const&... args) noexcept;
+    template<typename... Args>
+    inline int fatal(StringView const& name,
+        FormatString<sizeof...(Args)> const fmt,
+        Args const&... args) noexcept;
+    template<typename... Args>
+    inline int error(StringView const& name,
+        FormatString<sizeof...(Args)> const fmt,
+        Args const&... args) noexcept;
+    template<typename... Args>
+    inline int warn(StringView const& name,
+        FormatString<sizeof...(Args)> const fmt,
+        Args const&... args) noexcept;
+    template<typename... Args>
+    inline int note(StringView const& name,
+        FormatString<sizeof...(Args)> const fmt,
+        Args const&... args) noexcept;
+    template<typename... Args>
+    inline int info(StringView const& name,
+        FormatString<sizeof...(Args)> const fmt,
+        Args const&... args) noexcept;
+    template<typename... Args>
+    inline int trace(StringView const& name,
+        FormatString<sizeof...(Args)> const fmt,
+        Args const&... args) noexcept;
+    template<typename... Args>
+    inline int debug(StringView const& name,
+        FormatString<sizeof...(Args)> const fmt,
+        Args const&... args) noexcept;
+    template<typename... Args>
+    inline int detail(StringView const& name,
+        FormatString<sizeof...(Args)> const fmt,
+        Args const&... args) noexcept;
+    /**
+     * Logging methods, a string msg (literal, char const* or std::string)
+     * passed on without copy, other msg formatted by std::ostream <<
+     */
+    inline Logger& f(StringView const& msg) noexcept;
+    inline Logger& f(StringView const& name, StringView const& msg) noexcept;
     template<typename T>
-    typename std::enable_if<!std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& f(T const& msg)
-        noexcept;
+    inline typename std::enable_if<!std::is_convertible<T const&,
+        StringView>::value, Logger>::type& f(T const& msg) noexcept;
     template<typename T>
-    typename std::enable_if<!std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& f(
-        std::string const& name, T const& msg) noexcept;
-    template<uint32_t sz> Logger& f(const char(&msg)[sz]) noexcept;
-    template<uint32_t sz> Logger& f(
-        std::string const& name, const char(&msg)[sz]) noexcept;
-    // e
-    template<typename T = std::string>
-    typename std::enable_if<std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& e(T const& msg)
-        noexcept;
-    template<typename T = std::string>
-    typename std::enable_if<std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& e(
-        std::string const& name, T const& msg) noexcept;
+    inline typename std::enable_if<!std::is_convertible<T const&,
+        StringView>::value, Logger>::type& f(StringView const& name,
+        T const& msg) noexcept;
+    inline Logger& e(StringView const& msg) noexcept;
+    inline Logger& e(StringView const& name, StringView const& msg) noexcept;
     template<typename T>
-    typename std::enable_if<!std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& e(T const& msg)
-        noexcept;
+    inline typename std::enable_if<!std::is_convertible<T const&,
+        StringView>::value, Logger>::type& e(T const& msg) noexcept;
     template<typename T>
-    typename std::enable_if<!std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& e(
-        std::string const& name, T const& msg) noexcept;
-    template<uint32_t sz> Logger& e(char const(&msg)[sz]) noexcept;
-    template<uint32_t sz> Logger& e(
-        std::string const& name, char const(&msg)[sz]) noexcept;
-    // w
-    template<typename T = std::string>
-    typename std::enable_if<std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& w(T const& msg)
-        noexcept;
-    template<typename T = std::string>
-    typename std::enable_if<std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& w(
-        std::string const& name, T const& msg) noexcept;
+    inline typename std::enable_if<!std::is_convertible<T const&,
+        StringView>::value, Logger>::type& e(StringView const& name,
+        T const& msg) noexcept;
+    inline Logger& w(StringView const& msg) noexcept;
+    inline Logger& w(StringView const& name, StringView const& msg) noexcept;
     template<typename T>
-    typename std::enable_if<!std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& w(T const& msg)
-        noexcept;
+    inline typename std::enable_if<!std::is_convertible<T const&,
+        StringView>::value, Logger>::type& w(T const& msg) noexcept;
     template<typename T>
-    typename std::enable_if<!std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& w(
-        std::string const& name, T const& msg) noexcept;
-    template<uint32_t sz> Logger& w(char const(&msg)[sz]) noexcept;
-    template<uint32_t sz> Logger& w(
-        std::string const& name, char const(&msg)[sz]) noexcept;
-    // n
-    template<typename T = std::string>
-    typename std::enable_if<std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& n(T const& msg)
-        noexcept;
-    template<typename T = std::string>
-    typename std::enable_if<std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& n(
-        std::string const& name, T const& msg) noexcept;
+    inline typename std::enable_if<!std::is_convertible<T const&,
+        StringView>::value, Logger>::type& w(StringView const& name,
+        T const& msg) noexcept;
+    inline Logger& n(StringView const& msg) noexcept;
+    inline Logger& n(StringView const& name, StringView const& msg) noexcept;
     template<typename T>
-    typename std::enable_if<!std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& n(T const& msg)
-        noexcept;
+    inline typename std::enable_if<!std::is_convertible<T const&,
+        StringView>::value, Logger>::type& n(T const& msg) noexcept;
     template<typename T>
-    typename std::enable_if<!std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& n(
-        std::string const& name, T const& msg) noexcept;
-    template<uint32_t sz> Logger& n(char const(&msg)[sz]) noexcept;
-    template<uint32_t sz> Logger& n(
-        std::string const& name, char const(&msg)[sz]) noexcept;
-    // i
-    template<typename T = std::string>
-    typename std::enable_if<std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& i(T const& msg)
-        noexcept;
-    template<typename T = std::string>
-    typename std::enable_if<std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& i(
-        std::string const& name, T const& msg) noexcept;
+    inline typename std::enable_if<!std::is_convertible<T const&,
+        StringView>::value, Logger>::type& n(StringView const& name,
+        T const& msg) noexcept;
+    inline Logger& i(StringView const& msg) noexcept;
+    inline Logger& i(StringView const& name, StringView const& msg) noexcept;
     template<typename T>
-    typename std::enable_if<!std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& i(T const& msg)
-        noexcept;
+    inline typename std::enable_if<!std::is_convertible<T const&,
+        StringView>::value, Logger>::type& i(T const& msg) noexcept;
     template<typename T>
-    typename std::enable_if<!std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& i(
-        std::string const& name, T const& msg) noexcept;
-    template<uint32_t sz> Logger& i(char const(&msg)[sz]) noexcept;
-    template<uint32_t sz> Logger& i(
-        std::string const& name, char const(&msg)[sz]) noexcept;
-    // d
-    template<typename T = std::string>
-    typename std::enable_if<std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& d(T const& msg)
-        noexcept;
-    template<typename T = std::string>
-    typename std::enable_if<std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& d(
-        std::string const& name, T const& msg) noexcept;
+    inline typename std::enable_if<!std::is_convertible<T const&,
+        StringView>::value, Logger>::type& i(StringView const& name,
+        T const& msg) noexcept;
+    inline Logger& d(StringView const& msg) noexcept;
+    inline Logger& d(StringView const& name, StringView const& msg) noexcept;
     template<typename T>
-    typename std::enable_if<!std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& d(T const& msg)
-        noexcept;
+    inline typename std::enable_if<!std::is_convertible<T const&,
+        StringView>::value, Logger>::type& d(T const& msg) noexcept;
     template<typename T>
-    typename std::enable_if<!std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& d(
-        std::string const& name, T const& msg) noexcept;
-    template<uint32_t sz> Logger& d(char const(&msg)[sz]) noexcept;
-    template<uint32_t sz> Logger& d(
-        std::string const& name, char const(&msg)[sz]) noexcept;
-    // <<
-    template<typename T = std::string>
-    typename std::enable_if<std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& operator<<(
+    inline typename std::enable_if<!std::is_convertible<T const&,
+        StringView>::value, Logger>::type& d(StringView const& name,
         T const& msg) noexcept;
+    struct StreamRecord;
+    /**
+     * Start one record of logger level built by chained <<, e.g.
+     * logger << "a" << x << "b", appended when the full expression ends
+     */
     template<typename T>
-    typename std::enable_if<!std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& operator<<(
-        T const& msg) noexcept;
-    template<uint32_t sz>
-    Logger& operator<<(char const(&msg)[sz]) noexcept;
-    // ,
-    template<typename T = std::string>
-    typename std::enable_if<std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& operator,(
-        T const& msg) noexcept;
+    inline StreamRecord operator<<(T const& msg) noexcept;
+    /// Same as << but a raw record: msg only, no header and no newline
     template<typename T>
-    typename std::enable_if<!std::is_same<std::string,
-        typename std::decay<T>::type>::value, Logger>::type& operator,(
-        T const& msg) noexcept;
-    template<uint32_t sz>
-    Logger& operator,(char const(&msg)[sz]) noexcept;
-    /// Finish log
+    inline StreamRecord operator,(T const& msg) noexcept;
+    /// Finish log, drain and stop async backend first if async
     void finish() noexcept;
 protected:
+    friend struct LoggerHandle;
+    /**
+     * Bumped when registry, default logger or any log level changed
+     * @note Starts from 1, LoggerHandle uses 0 as never loaded
+     */
+    static std::atomic<uint64_t> generation;
+    static inline void bumpGeneration() noexcept;
+    /**
+     * @struct Config
+     * Options read by append, packed in Logger::config so a reader gets all
+     * of them by one load and a writer changes them at once
+     */
+    struct Config {
+        LogLevel logLevel{ LogLevel::Note };
+        /// Highest level kept by flight recorder, Min when none kept
+        LogLevel flightLevel{ LogLevel::Min };
+        Outputs outputs{ Output::CoutOrCerr };
+        bool hasIdx{ true }; //序列号
+        bool hasTid{ false };//线程id
+        inline uint64_t pack() const noexcept;
+        static inline Config unpack(uint64_t const v) noexcept;
+    };
+    inline Config loadConfig() const noexcept;
+    /// Change config by CAS, @return config after change
+    Config updateConfig(std::function<void(Config&)> const& change) noexcept;
+    /// One record, data borrowed from caller or from AsyncSlot
+    struct Record {
+        char const* name{ nullptr };
+        size_t nameLen{ 0 };
+        /// Macro callsite, its suffix used instead of file and line
+        Callsite const* site{ nullptr };
+        char const* file{ nullptr };
+        int line{ -1 };
+        char const* msg{ nullptr };
+        size_t msgLen{ 0 };
+        LogLevel level{ LogLevel::Unchange };
+        /// Raw record: msg only, no header and no newline
+        bool raw{ false };
+        uint64_t idx{ 0 };
+        uint64_t tid{ 0 };
+        timespec time{ 0, 0 };
+        /// Config when appended, async write follows it too
+        Config config;
+    };
+    /// Async queue cell, strings keep capacity between records
+    struct AsyncSlot {
+        Record record;
+        std::string name;
+        std::string file;
+        std::string msg;
+    };
+    /**
+     * Level check, return level to use or LogLevel::Unchange to skip
+     * @param config set to config the check used
+     */
+    LogLevel acceptLevel(LogLevel const& logLevel, Config& config) noexcept;
+    /// Keep a record filtered out by level in flight recorder, @return 0
+    int capture(Record const& record, LogLevel const& logLevel) noexcept;
+    /**
+     * Queue or write record
+     * @note Fata is written by caller after queued records, and synced
+     */
+    int dispatch(Record& record) noexcept;
+    /// Format and output a record, called in caller or backend thread
+    int write(Record const& record) noexcept;
+    /// Signal handler of installCrashHandlers
+    static void onCrashSignal(int const sig, siginfo_t* const info,
+        void* const context) noexcept;
+    /**
+     * Write what is buffered and @a head then backtrace @a frames, sync
+     * @note No allocation, write(2)/pwrite(2) only; locks try_locked, see
+     * installCrashHandlers
+     */
+    void crashFlush(char const* const head, size_t const headLen,
+        void* const* const frames, int const frameCount) noexcept;
+    /// Render queued @a record as a line to ring or @a fd, async-signal-safe
+    void crashWriteRecord(int const fd, Record const& record) noexcept;
+    /**
+     * Push record to async queue
+     * @return 0 when queued, -ENOBUFS when dropped, -ESHUTDOWN when backend
+     * stopped and caller should write itself
+     */
+    int asyncPush(Record const& record) noexcept;
+    void asyncRun() noexcept;
+    /// Stop backend after drain
+    void stopAsync() noexcept;
+    /// Flush and close log file
+    void closeFile() noexcept;
+    /// Close log, io_uring or direct writes done first, under writemutex
+    void closeLog() noexcept;
+    /// Open log file and set stdio buffer, under writemutex
+    FILE* openFile(char const* const mode) noexcept;
+    /// Flush under writemutex
+    void flushFile() noexcept;
+    /// Flush when not flushed data too old, called by timer
+    void flushIfAged(uint64_t const nowMs) noexcept;
+    /// Write to log by stdio, io_uring or direct, @return 0 or -errno
+    int writeFile(char const* const data, size_t const len) noexcept;
+    /// Write repeat count line if any, under writemutex
+    void writeRepeats() noexcept;
+    /// Write repeat count and forget last record, under writemutex
+    void endRepeats() noexcept;
+    /// Shift base.rotating => base.1 => ... => base.N, drop older
+    void shiftGenerations(std::string const& base) noexcept;
+    /// shiftGenerations of files rotated, by age flusher or finish
+    void shiftRotated() noexcept;
+    /// shiftGenerations of kRotated* bits @a rotated, under rotateMutex
+    void shiftRotatedLocked(uint32_t const rotated) noexcept;
+    /// Write an encoded binary record
+    int writeBinary(BinaryFormat const& format, char const* const types,
+        char const* const args, size_t const argsLen) noexcept;
+    /// Open .bin and write header, under binMutex
+    int openBinary(char const* const mode) noexcept;
+    /// Flush and close .bin, under binMutex
+    void closeBinary() noexcept;
     static std::string defaultLogFile;// Some global options
+    /// @note Caller should be pinned by EpochGuard
     static Logger& hasLogger(std::string const& file) noexcept;
     /**
      * Create a logger
@@ -297,34 +609,126 @@ protected:
     Logger(std::string const& path,Outputs const& outputs = Outputs{},int32_t const maxSize = -1,bool const trunc = false) noexcept;
     Logger(Logger const&) = delete;
     Logger& operator=(Logger const&) = delete;
-    void tryDoAcCb(std::string const& name, LogLevel const& logLevel, std::string const &msg) const noexcept;
+    void tryDoAcCb(StringView const& name, LogLevel const& logLevel, StringView const& msg) const noexcept;
     //Logger instances and related
     static Logger emptyLogger;
-    static boost::shared_mutex instancesRwlock;
-    static std::map<std::string, boost::shared_ptr<Logger>> instances;
+    using Instances = std::map<std::string, boost::shared_ptr<Logger>>;
+    /**
+     * Copy-on-write snapshot, read under EpochGuard without lock, replaced
+     * under instancesMutex and old one freed by EpochRetire
+     */
+    static std::atomic<Instances const*> instances;
+    static std::mutex instancesMutex;
+    /// Free last snapshot when process exit
+    struct InstancesKeeper {
+        ~InstancesKeeper();
+    };
+    static InstancesKeeper instancesKeeper;
     //Instance properties
+    char configPad0[kCacheLineSize];
+    /// Packed Config, on its own cache line with appendCallback
+    std::atomic<uint64_t> config{ Config().pack() };
+    /// Read under EpochGuard, replaced one freed by EpochRetire
+    std::atomic<AppendCallback const*> appendCallback{ nullptr };
+    char configPad1[kCacheLineSize - sizeof(std::atomic<uint64_t>) -
+        sizeof(std::atomic<AppendCallback const*>)];
     mutable std::mutex writemutex;
-    LogLevel logLevel { LogLevel::Note };
-    LogLevel spinOnceLogLevel{ LogLevel::Unchange };
     FILE* log{ nullptr };
     std::string const path;
-    Outputs outputs{ Output::CoutOrCerr };
     uint32_t maxSize{ kDefaultLogSize };
-    bool hasIdx{ true }; //序列号
-    bool hasTid{ false };//线程id
-    AppendCallback appendCallback{ nullptr };
+    /// Bytes in live log file, seeded by fstat when open, under writemutex
+    uint64_t fileSize{ 0 };
+    // Flush state, under writemutex
+    FlushPolicy flushPolicy;
+    uint32_t unflushed{ 0 };
+    /// Monotonic ms when first not flushed byte written, 0 when none
+    uint64_t unflushedSince{ 0 };
+    // Repeat collapsing, under writemutex, collapseHoldMs 0 when off
+    uint32_t collapseHoldMs{ 0 };
+    /// Hash of last record written, 0 when none
+    uint64_t repeatHash{ 0 };
+    LogLevel repeatLevel{ LogLevel::Unchange };
+    uint64_t repeats{ 0 };
+    /// Monotonic ms of first repeat not written
+    uint64_t repeatSince{ 0 };
+    std::atomic<uint32_t> generations{ 1 };
+    /**
+     * Only one rotation or shift at a time, shift done out of writemutex
+     * @note Taken before writemutex, after binMutex
+     */
+    std::mutex rotateMutex;
+    /// kRotated* bits of files renamed to .rotating, not rotated again
+    /// until age flusher shifted generations
+    std::atomic<uint32_t> rotated{ 0 };
     mutable boost::shared_mutex acNameFiltersRwlock;
-    /// @note empty name to filter nil and empty
-    std::set<std::string> acNameFilters;
+    /**
+     * Sorted, looked up by StringView without making a std::string
+     * @note empty name to filter nil and empty
+     */
+    std::vector<std::string> acNameFilters;
+    // Async backend, queue only freed with logger
+    std::atomic<bool> async{ false };
+    Backpressure backpressure{ Backpressure::Block };
+    std::unique_ptr<BoundedQueue<AsyncSlot>> asyncQueue;
+    std::thread asyncThread;
+    std::mutex asyncCtlMutex;
+    std::mutex asyncMutex;
+    std::condition_variable asyncCond;
+    std::atomic<bool> asyncStop{ false };
+    std::atomic<bool> asyncSleeping{ false };
+    /// Producers in asyncPush, stopAsync waits them before last drain
+    std::atomic<uint32_t> asyncPushers{ 0 };
+    /// Producers parked on asyncCond by Block backpressure
+    std::atomic<uint32_t> asyncBlocked{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    /// Records taken off queue by backend or overwrite
+    std::atomic<uint64_t> asyncPopped{ 0 };
+    // Binary mode, file and state under binMutex
+    std::atomic<bool> binary{ false };
+    std::mutex binMutex;
+    FILE* binLog{ nullptr };
+    uint64_t binSize{ 0 };
+    /// Monotonic ms when first not flushed record written, 0 when none
+    uint64_t binUnflushedSince{ 0 };
+    /// Format ids already written to current .bin
+    std::vector<bool> binDefined;
+    /// Flight recorder, replaced one freed by EpochRetire
+    std::atomic<FlightRecorder*> flightRecorder{ nullptr };
+    /// One dump at a time
+    std::mutex flightMutex;
+    /// Ring file replacing file output, under writemutex
+    std::unique_ptr<MmapRing> ring;
+    /// io_uring writer of log file, under writemutex
+    std::unique_ptr<UringWriter> uring;
+    /// O_DIRECT writer of log file, under writemutex
+    std::unique_ptr<DirectWriter> direct;
 };
 //--
+/// Start the timer of FlushPolicy::maxAgeMs once
+extern void StartAgeFlusher() noexcept;
 extern std::string LogRealTime() noexcept;
+extern std::string LogRealTime(timespec const& tp) noexcept;
+/// Max bytes FormatLogRealTime writes
+constexpr uint32_t kLogRealTimeMaxLen = 48;
+/**
+ * Format @a tp as "tz YYYY-MM-DD HH:MM:SS.nnnnnnnnn" into @a buf
+ * @param buf at least kLogRealTimeMaxLen bytes, no '\0' appended
+ * @return bytes written
+ * @note Text before the fraction is cached per thread for each second
+ */
+extern uint32_t FormatLogRealTime(timespec const& tp, char* const buf) noexcept;
 inline void Logger::setDefaultLogger(std::string const& path) noexcept
 {
     if (!path.empty()) {
         Logger::defaultLogFile = path;
+        Logger::bumpGeneration();
     }
 }
+inline void Logger::bumpGeneration() noexcept
+{
+    // seq_cst: pairs with EpochPin fence, see LoggerHandle::get
+    Logger::generation.fetch_add(1);
+}
 inline std::string Logger::getDefaultLogger() noexcept
 {
     return Logger::defaultLogFile;
@@ -336,383 +740,553 @@ inline Logger::operator bool() const noexcept
 }
 inline bool Logger::isLogable(LogLevel const& ll) const noexcept
 {
-    return this->logLevel >= ll;
+    return this->getAcceptLevel() >= ll;
 }
-inline void Logger::setOutputs(Outputs const& o) noexcept
+inline LogLevel Logger::getAcceptLevel() const noexcept
 {
-    this->outputs = o;
+    Config const c = this->loadConfig();
+    return c.flightLevel > c.logLevel ? c.flightLevel : c.logLevel;
 }
-inline void Logger::setAppendCallback(AppendCallback const& ac) noexcept
+inline LogLevel Logger::getLogLevel() const noexcept
 {
-    this->appendCallback = ac;
+    return this->loadConfig().logLevel;
 }
-inline void Logger::enableIdx(bool const enable) noexcept
+inline uint64_t Logger::Config::pack() const noexcept
 {
-    this->hasIdx = enable;
+    // level | flight level << 8 | outputs << 16 | idx << 24 | tid << 25
+    return uint64_t(this->logLevel) |
+        uint64_t(this->flightLevel) << 8 |
+        (uint64_t(this->outputs) & 0xff) << 16 |
+        uint64_t(this->hasIdx) << 24 | uint64_t(this->hasTid) << 25;
 }
-inline void Logger::enableTid(bool const enable) noexcept
+inline Logger::Config Logger::Config::unpack(uint64_t const v) noexcept
 {
-    this->hasTid = enable;
+    Config c;
+    c.logLevel = static_cast<LogLevel>(v & 0xff);
+    c.flightLevel = static_cast<LogLevel>((v >> 8) & 0xff);
+    c.outputs = Outputs(Flag((v >> 16) & 0xff));
+    c.hasIdx = (v >> 24) & 1;
+    c.hasTid = (v >> 25) & 1;
+    return c;
 }
-constexpr inline LogLevel GetNextLogLevel(LogLevel const& logLevel) noexcept
+inline Logger::Config Logger::loadConfig() const noexcept
 {
-    return static_cast<LogLevel>(static_cast<uint32_t>(logLevel) + 1);
+    return Config::unpack(this->config.load(std::memory_order_acquire));
 }
-static inline LogLevel& ToNextLogLevel(LogLevel& logLevel) noexcept
+inline bool Logger::isAsync() const noexcept
 {
-    return logLevel = GetNextLogLevel(logLevel);
+    return this->async.load(std::memory_order_acquire);
 }
-//--
-inline Logger& Logger::getFatal(std::string const& path, Outputs const& outputs) noexcept
+inline bool Logger::isBinary() const noexcept
 {
-    return Logger::getLogger(LogLevel::Fata, path, outputs);
+    return this->binary.load(std::memory_order_acquire);
 }
-inline Logger& Logger::getError(std::string const& path, Outputs const& outputs) noexcept
+template<typename... Args>
+int Logger::appendBinary(BinaryFormat const& format, Args const&... args) noexcept
 {
-    return Logger::getLogger(LogLevel::Erro, path, outputs);
+    size_t const size = BinarySize(args...);
+    char stack[256];
+    std::unique_ptr<char[]> heap;
+    char* buf = stack;
+    if (size > sizeof(stack)) {
+        heap.reset(new char[size]);
+        buf = heap.get();
+    }
+    BinaryPut(buf, args...);
+    return this->writeBinary(format, BinaryTypes<Args...>::value, buf, size);
 }
-inline Logger& Logger::getWarning(std::string const& path, Outputs const& outputs) noexcept
+template<typename... Args>
+int Logger::format(LogLevel const& logLevel, StringView const& name,
+    char const* const file, int const line,
+    FormatString<sizeof...(Args)> const fmt, Args const&... args) noexcept
 {
-    return Logger::getLogger(LogLevel::Warn, path, outputs);
+    // Cheap check before formatting, append checks again
+    if (!this->isLogable(logLevel)) {
+        return 0;
+    }
+    ScopedFormatBuffer scoped;
+    FormatBuffer& buffer = scoped.buffer();
+    FormatTo(buffer, fmt.str, args...);
+    return this->append(name, file, line,
+        StringView(buffer.data(), buffer.size()), logLevel);
 }
-inline Logger& Logger::getNote(std::string const& path, Outputs const& outputs) noexcept
+template<typename... Args>
+int Logger::format(Callsite const& site,
+    FormatString<sizeof...(Args)> const fmt,
+    Args const&... args) noexcept
 {
-    return Logger::getLogger(LogLevel::Note, path, outputs);
+    if (!this->isLogable(site.level)) {
+        return 0;
+    }
+    ScopedFormatBuffer scoped;
+    FormatBuffer& buffer = scoped.buffer();
+    FormatTo(buffer, fmt.str, args...);
+    return this->append(site, StringView(buffer.data(), buffer.size()));
 }
-inline Logger& Logger::getInfo(std::string const& path, Outputs const& outputs) noexcept
+template<typename... Args>
+inline int Logger::fatal(StringView const& name,
+    FormatString<sizeof...(Args)> const fmt,
+    Args const&... args) noexcept
 {
-    return Logger::getLogger(LogLevel::Info, path, outputs);
+    return this->format(LogLevel::Fata, name, nullptr, -1, fmt, args...);
 }
-inline Logger& Logger::getTrace(std::string const& path, Outputs const& outputs) noexcept
+template<typename... Args>
+inline int Logger::error(StringView const& name,
+    FormatString<sizeof...(Args)> const fmt,
+    Args const&... args) noexcept
 {
-    return Logger::getLogger(LogLevel::Trac, path, outputs);
+    return this->format(LogLevel::Erro, name, nullptr, -1, fmt, args...);
 }
-inline Logger& Logger::getDebug(std::string const& path, Outputs const& outputs) noexcept
+template<typename... Args>
+inline int Logger::warn(StringView const& name,
+    FormatString<sizeof...(Args)> const fmt,
+    Args const&... args) noexcept
 {
-    return Logger::getLogger(LogLevel::Debu, path, outputs);
+    return this->format(LogLevel::Warn, name, nullptr, -1, fmt, args...);
 }
-inline Logger& Logger::getDetail(std::string const& path, Outputs const& outputs) noexcept
+template<typename... Args>
+inline int Logger::note(StringView const& name,
+    FormatString<sizeof...(Args)> const fmt,
+    Args const&... args) noexcept
 {
-    return Logger::getLogger(LogLevel::Deta, path, outputs);
+    return this->format(LogLevel::Note, name, nullptr, -1, fmt, args...);
 }
-
-/**********/
-/*std::is_same 判断类型是否一致  std::decay 退化类型的修饰*/
-/*std::enable_if判断退化后的模板参数T与std::string类型一致,则使用Logger作为返回参数*/
-// f
-template<typename T>
-typename std::enable_if<std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::f(T const& msg) noexcept
+template<typename... Args>
+inline int Logger::info(StringView const& name,
+    FormatString<sizeof...(Args)> const fmt,
+    Args const&... args) noexcept
 {
-    this->append(nullptr, nullptr, -1, msg, LogLevel::Fata);
-    return *this;
+    return this->format(LogLevel::Info, name, nullptr, -1, fmt, args...);
 }
-template<typename T>
-typename std::enable_if<std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::f(std::string const& name, T const& msg) noexcept
+template<typename... Args>
+inline int Logger::trace(StringView const& name,
+    FormatString<sizeof...(Args)> const fmt,
+    Args const&... args) noexcept
 {
-    this->append(name.c_str(), nullptr, -1, msg, LogLevel::Fata);
-    return *this;
+    return this->format(LogLevel::Trac, name, nullptr, -1, fmt, args...);
 }
-template<typename T>
-typename std::enable_if<!std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::f(T const& msg) noexcept
+template<typename... Args>
+inline int Logger::debug(StringView const& name,
+    FormatString<sizeof...(Args)> const fmt,
+    Args const&... args) noexcept
 {
-    std::stringstream ss;
-    ss << msg;
-    this->append(nullptr, nullptr, -1, ss.str(), LogLevel::Fata);
-    return *this;
+    return this->format(LogLevel::Debu, name, nullptr, -1, fmt, args...);
 }
-template<typename T>
-typename std::enable_if<!std::is_same<std::string, typename std::decay<T>::type>::value, Logger>::type&
-Logger::f(std::string const& name, T const& msg) noexcept
+template<typename... Args>
+inline int Logger::detail(StringView const& name,
+    FormatString<sizeof...(Args)> const fmt,
+    Args const&... args) noexcept
 {
-    std::stringstream ss;
-    ss << msg;
-    this->append(name.c_str(), nullptr, -1, ss.str(), LogLevel::Fata);
-    return *this;
+    return this->format(LogLevel::Deta, name, nullptr, -1, fmt, args...);
 }
-template<uint32_t sz> Logger&
-Logger::f(char const(&msg)[sz]) noexcept
+inline uint64_t Logger::getDropped() const noexcept
 {
-    this->append(nullptr, nullptr, -1, msg, LogLevel::Fata);
-    return *this;
+    return this->dropped.load(std::memory_order_relaxed);
 }
-template<uint32_t sz> Logger&
-Logger::f(std::string const& name, char const(&msg)[sz]) noexcept
+/**
+ * @struct LoggerHandle
+ * Cached default Logger and its level, used by loghelper macros
+ *
+ * Revalidated only when Logger generation changed, so a disabled level check
+ * is one relaxed atomic load and an enabled log does not touch the registry.
+ * @note Not thread safe, use one per thread (e.g. static thread_local)
+ * @note Call get() under EpochGuard: when the generation it checks after pin
+ * is unchanged, a released Logger cannot be freed before unpin
+ */
+struct LoggerHandle {
+    constexpr LoggerHandle() noexcept {}
+    inline bool isLogable(LogLevel const& ll) noexcept;
+    inline Logger& get() noexcept;
+private:
+    inline bool valid() const noexcept;
+    void refresh() noexcept;
+    Logger* logger{ nullptr };
+    LogLevel logLevel{ LogLevel::Min };
+    uint64_t generation{ 0 };
+};
+inline bool LoggerHandle::valid() const noexcept
 {
-    this->append(name, nullptr, -1, msg, LogLevel::Fata);
-    return *this;
+    return Logger::generation.load(std::memory_order_relaxed) ==
+        this->generation;
 }
-// e
-template<typename T>
-typename std::enable_if<std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::e(T const& msg) noexcept
+inline bool LoggerHandle::isLogable(LogLevel const& ll) noexcept
 {
-    this->append(nullptr, nullptr, -1, msg, LogLevel::Erro);
-    return *this;
+    if (!this->valid()) {
+        this->refresh();
+    }
+    return this->logLevel >= ll;
 }
-template<typename T>
-typename std::enable_if<std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::e(std::string const& name, T const& msg) noexcept
+inline Logger& LoggerHandle::get() noexcept
 {
-    this->append(name.c_str(), nullptr, -1, msg, LogLevel::Erro);
-    return *this;
+    if (!this->valid()) {
+        this->refresh();
+    }
+    return *(this->logger);
 }
-template<typename T>
-typename std::enable_if<!std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::e(T const& msg) noexcept
+constexpr inline LogLevel GetNextLogLevel(LogLevel const& logLevel) noexcept
 {
-    std::stringstream ss;
-    ss << msg;
-    this->append(nullptr, nullptr, -1, ss.str(), LogLevel::Erro);
-    return *this;
+    return static_cast<LogLevel>(static_cast<uint32_t>(logLevel) + 1);
 }
-template<typename T>
-typename std::enable_if<!std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::e(std::string const& name, T const& msg) noexcept
+static inline LogLevel& ToNextLogLevel(LogLevel& logLevel) noexcept
 {
-    std::stringstream ss;
-    ss << msg;
-    this->append(name.c_str(), nullptr, -1, ss.str(), LogLevel::Erro);
-    return *this;
+    return logLevel = GetNextLogLevel(logLevel);
 }
-template<uint32_t sz> Logger&
-Logger::e(char const(&msg)[sz]) noexcept
+//--
+/**********/
+/*std::is_convertible 判断能否转为StringView, 字符串直接传递, 其他类型经std::ostream格式化*/
+// f
+inline Logger& Logger::f(StringView const& msg) noexcept
 {
-    this->append(nullptr, nullptr, -1, msg, LogLevel::Erro);
+    this->append(StringView(), nullptr, -1, msg, LogLevel::Fata);
     return *this;
 }
-template<uint32_t sz> Logger&
-Logger::e(std::string const& name, char const(&msg)[sz]) noexcept
+inline Logger& Logger::f(StringView const& name, StringView const& msg) noexcept
 {
-    this->append(name, nullptr, -1, msg, LogLevel::Erro);
+    this->append(name, nullptr, -1, msg, LogLevel::Fata);
     return *this;
 }
-// w
 template<typename T>
-typename std::enable_if<std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::w(T const& msg) noexcept
+inline typename std::enable_if<!std::is_convertible<T const&, StringView>::value, Logger>::type&
+Logger::f(T const& msg) noexcept
 {
-    this->append(nullptr, nullptr, -1, msg, LogLevel::Warn);
-    return *this;
+    return this->f(StringView(), msg);
 }
 template<typename T>
-typename std::enable_if<std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::w(std::string const& name, T const& msg) noexcept
+inline typename std::enable_if<!std::is_convertible<T const&, StringView>::value, Logger>::type&
+Logger::f(StringView const& name, T const& msg) noexcept
 {
-    this->append(name.c_str(), nullptr, -1, msg, LogLevel::Warn);
+    if (this->isLogable(LogLevel::Fata)) {
+        ScopedLogStream ss;
+        ss.stream() << msg;
+        this->append(name, nullptr, -1, ss.view(), LogLevel::Fata);
+    }
     return *this;
 }
-template<typename T>
-typename std::enable_if<!std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::w(T const& msg) noexcept
+// e
+inline Logger& Logger::e(StringView const& msg) noexcept
 {
-    std::stringstream ss;
-    ss << msg;
-    this->append(nullptr, nullptr, -1, ss.str(), LogLevel::Warn);
+    this->append(StringView(), nullptr, -1, msg, LogLevel::Erro);
+    return *this;
+}
+inline Logger& Logger::e(StringView const& name, StringView const& msg) noexcept
+{
+    this->append(name, nullptr, -1, msg, LogLevel::Erro);
     return *this;
 }
 template<typename T>
-typename std::enable_if<!std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::w(std::string const& name, T const& msg) noexcept
+inline typename std::enable_if<!std::is_convertible<T const&, StringView>::value, Logger>::type&
+Logger::e(T const& msg) noexcept
 {
-    std::stringstream ss;
-    ss << msg;
-    this->append(name.c_str(), nullptr, -1, ss.str(), LogLevel::Warn);
+    return this->e(StringView(), msg);
+}
+template<typename T>
+inline typename std::enable_if<!std::is_convertible<T const&, StringView>::value, Logger>::type&
+Logger::e(StringView const& name, T const& msg) noexcept
+{
+    if (this->isLogable(LogLevel::Erro)) {
+        ScopedLogStream ss;
+        ss.stream() << msg;
+        this->append(name, nullptr, -1, ss.view(), LogLevel::Erro);
+    }
     return *this;
 }
-template<uint32_t sz> Logger&
-Logger::w(char const(&msg)[sz]) noexcept
+// w
+inline Logger& Logger::w(StringView const& msg) noexcept
 {
-    this->append(nullptr, nullptr, -1, msg, LogLevel::Warn);
+    this->append(StringView(), nullptr, -1, msg, LogLevel::Warn);
     return *this;
 }
-template<uint32_t sz> Logger&
-Logger::w(std::string const& name, char const(&msg)[sz]) noexcept
+inline Logger& Logger::w(StringView const& name, StringView const& msg) noexcept
 {
     this->append(name, nullptr, -1, msg, LogLevel::Warn);
     return *this;
 }
-// n
 template<typename T>
-typename std::enable_if<std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::n(T const& msg) noexcept
+inline typename std::enable_if<!std::is_convertible<T const&, StringView>::value, Logger>::type&
+Logger::w(T const& msg) noexcept
 {
-    this->append(nullptr, nullptr, -1, msg, LogLevel::Note);
-    return *this;
+    return this->w(StringView(), msg);
 }
 template<typename T>
-typename std::enable_if<std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::n(std::string const& name, T const& msg) noexcept
+inline typename std::enable_if<!std::is_convertible<T const&, StringView>::value, Logger>::type&
+Logger::w(StringView const& name, T const& msg) noexcept
 {
-    this->append(name.c_str(), nullptr, -1, msg, LogLevel::Note);
+    if (this->isLogable(LogLevel::Warn)) {
+        ScopedLogStream ss;
+        ss.stream() << msg;
+        this->append(name, nullptr, -1, ss.view(), LogLevel::Warn);
+    }
     return *this;
 }
-template<typename T>
-typename std::enable_if<!std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::n(T const& msg) noexcept
+// n
+inline Logger& Logger::n(StringView const& msg) noexcept
 {
-    std::stringstream ss;
-    ss << msg;
-    this->append(nullptr, nullptr, -1, ss.str(), LogLevel::Note);
+    this->append(StringView(), nullptr, -1, msg, LogLevel::Note);
     return *this;
 }
-template<typename T>
-typename std::enable_if<!std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::n(std::string const& name, T const& msg) noexcept
+inline Logger& Logger::n(StringView const& name, StringView const& msg) noexcept
 {
-    std::stringstream ss;
-    ss << msg;
-    this->append(name.c_str(), nullptr, -1, ss.str(), LogLevel::Note);
+    this->append(name, nullptr, -1, msg, LogLevel::Note);
     return *this;
 }
-template<uint32_t sz> Logger&
-Logger::n(char const(&msg)[sz]) noexcept
+template<typename T>
+inline typename std::enable_if<!std::is_convertible<T const&, StringView>::value, Logger>::type&
+Logger::n(T const& msg) noexcept
 {
-    this->append(nullptr, nullptr, -1, msg, LogLevel::Note);
-    return *this;
+    return this->n(StringView(), msg);
 }
-template<uint32_t sz> Logger&
-Logger::n(std::string const& name, char const(&msg)[sz]) noexcept
+template<typename T>
+inline typename std::enable_if<!std::is_convertible<T const&, StringView>::value, Logger>::type&
+Logger::n(StringView const& name, T const& msg) noexcept
 {
-    this->append(name, nullptr, -1, msg, LogLevel::Note);
+    if (this->isLogable(LogLevel::Note)) {
+        ScopedLogStream ss;
+        ss.stream() << msg;
+        this->append(name, nullptr, -1, ss.view(), LogLevel::Note);
+    }
     return *this;
 }
 // i
-template<typename T>
-typename std::enable_if<std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::i(T const& msg) noexcept
+inline Logger& Logger::i(StringView const& msg) noexcept
 {
-    this->append(nullptr, nullptr, -1, msg, LogLevel::Info);
+    this->append(StringView(), nullptr, -1, msg, LogLevel::Info);
     return *this;
 }
-template<typename T>
-typename std::enable_if<std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::i(std::string const& name, T const& msg) noexcept
+inline Logger& Logger::i(StringView const& name, StringView const& msg) noexcept
 {
-    this->append(name.c_str(), nullptr, -1, msg, LogLevel::Info);
+    this->append(name, nullptr, -1, msg, LogLevel::Info);
     return *this;
 }
 template<typename T>
-typename std::enable_if<!std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
+inline typename std::enable_if<!std::is_convertible<T const&, StringView>::value, Logger>::type&
 Logger::i(T const& msg) noexcept
 {
-    std::stringstream ss;
-    ss << msg;
-    this->append(nullptr, nullptr, -1, ss.str(), LogLevel::Info);
-    return *this;
+    return this->i(StringView(), msg);
 }
 template<typename T>
-typename std::enable_if<!std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::i(std::string const& name, T const& msg) noexcept
+inline typename std::enable_if<!std::is_convertible<T const&, StringView>::value, Logger>::type&
+Logger::i(StringView const& name, T const& msg) noexcept
 {
-    std::stringstream ss;
-    ss << msg;
-    this->append(name.c_str(), nullptr, -1, ss.str(), LogLevel::Info);
+    if (this->isLogable(LogLevel::Info)) {
+        ScopedLogStream ss;
+        ss.stream() << msg;
+        this->append(name, nullptr, -1, ss.view(), LogLevel::Info);
+    }
     return *this;
 }
-template<uint32_t sz> Logger&
-Logger::i(char const(&msg)[sz]) noexcept
+// d
+inline Logger& Logger::d(StringView const& msg) noexcept
 {
-    this->append(nullptr, nullptr, -1, msg, LogLevel::Info);
+    this->append(StringView(), nullptr, -1, msg, LogLevel::Debu);
     return *this;
 }
-template<uint32_t sz> Logger&
-Logger::i(std::string const& name, char const(&msg)[sz]) noexcept
+inline Logger& Logger::d(StringView const& name, StringView const& msg) noexcept
 {
-    this->append(name, nullptr, -1, msg, LogLevel::Info);
+    this->append(name, nullptr, -1, msg, LogLevel::Debu);
     return *this;
 }
-// d
 template<typename T>
-typename std::enable_if<std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
+inline typename std::enable_if<!std::is_convertible<T const&, StringView>::value, Logger>::type&
 Logger::d(T const& msg) noexcept
 {
-    this->append(nullptr, nullptr, -1, msg, LogLevel::Debu);
-    return *this;
+    return this->d(StringView(), msg);
 }
 template<typename T>
-typename std::enable_if<std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::d(std::string const& name, T const& msg) noexcept
+inline typename std::enable_if<!std::is_convertible<T const&, StringView>::value, Logger>::type&
+Logger::d(StringView const& name, T const& msg) noexcept
 {
-    this->append(name.c_str(), nullptr, -1, msg, LogLevel::Debu);
+    if (this->isLogable(LogLevel::Debu)) {
+        ScopedLogStream ss;
+        ss.stream() << msg;
+        this->append(name, nullptr, -1, ss.view(), LogLevel::Debu);
+    }
     return *this;
 }
+// <<
+/**
+ * @struct Logger::StreamRecord
+ * Pieces of one chained << or , expression, appended as one record by
+ * the destructor of the temporary at the end of the full expression
+ */
+struct Logger::StreamRecord {
+    /// @param logger nullptr when level disabled, pieces then dropped
+    inline StreamRecord(Logger* const logger, LogLevel const& level,
+        bool const raw) noexcept: logger(logger), level(level), raw(raw) {}
+    inline StreamRecord(StreamRecord&& other) noexcept:
+        logger(other.logger), level(other.level), raw(other.raw),
+        stream(std::move(other.stream)) {
+        other.logger = nullptr;
+    }
+    StreamRecord(StreamRecord const&) = delete;
+    StreamRecord& operator=(StreamRecord const&) = delete;
+    inline ~StreamRecord() noexcept {
+        if (!this->logger) {
+            return;
+        }
+        if (this->raw) {
+            this->logger->append(this->stream.view(), this->level);
+        } else {
+            this->logger->append(StringView(), nullptr, -1,
+                this->stream.view(), this->level);
+        }
+    }
+    template<typename T>
+    inline StreamRecord& operator<<(T const& msg) noexcept {
+        if (this->logger) {
+            this->stream.stream() << msg;
+        }
+        return *this;
+    }
+    template<typename T>
+    inline StreamRecord& operator,(T const& msg) noexcept {
+        if (this->logger) {
+            this->stream.stream() << msg;
+        }
+        return *this;
+    }
+private:
+    Logger* logger;
+    LogLevel level;
+    bool raw;
+    ScopedLogStream stream;
+};
 template<typename T>
-typename std::enable_if<!std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::d(T const& msg) noexcept
+inline Logger::StreamRecord Logger::operator<<(T const& msg) noexcept
 {
-    std::stringstream ss;
-    ss << msg;
-    this->append(nullptr, nullptr, -1, ss.str(), LogLevel::Debu);
-    return *this;
+    StreamRecord record(this, this->getLogLevel(), false);
+    record << msg;
+    return record;
 }
 template<typename T>
-typename std::enable_if<!std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::d(std::string const& name, T const& msg) noexcept
+inline Logger::StreamRecord Logger::operator,(T const& msg) noexcept
 {
-    std::stringstream ss;
-    ss << msg;
-    this->append(name.c_str(), nullptr, -1, ss.str(), LogLevel::Debu);
-    return *this;
+    StreamRecord record(this, this->getLogLevel(), true);
+    record << msg;
+    return record;
 }
-template<uint32_t sz> Logger&
-Logger::d(char const(&msg)[sz]) noexcept
+/**
+ * @struct LevelLogger
+ * A Logger and a fixed level, got by Logger::getLevel() or getInfo() etc.
+ *
+ * The level is carried by value, so threads logging at different levels
+ * never mix and append has no spin once state to check. Whether the level
+ * is enabled is checked once when made, a disabled one formats nothing.
+ * @note Like Logger&, not to be used after the Logger released
+ */
+struct LevelLogger {
+    inline LevelLogger(Logger& logger, LogLevel const& logLevel) noexcept:
+        logger(&logger), logLevel(logLevel),
+        enabled(logger.isLogable(logLevel)) {}
+    inline Logger& getLogger() const noexcept { return *this->logger; }
+    inline LogLevel getLogLevel() const noexcept { return this->logLevel; }
+    inline bool isEnabled() const noexcept { return this->enabled; }
+    inline explicit operator bool() const noexcept { return this->enabled; }
+    /// Append msg at this level
+    inline int append(StringView const& msg) noexcept;
+    /// Append name + file + line + msg at this level
+    inline int append(StringView const& name, char const* const file,
+        int const line, StringView const& msg) noexcept;
+    /// Logger::format at this level
+    template<typename... Args>
+    inline int format(StringView const& name,
+        FormatString<sizeof...(Args)> const fmt,
+        Args const&... args) noexcept;
+    /// One record of chained <<, like Logger::operator<<
+    template<typename T>
+    inline Logger::StreamRecord operator<<(T const& msg) const noexcept;
+    /// One raw record of chained ,, like Logger::operator,
+    template<typename T>
+    inline Logger::StreamRecord operator,(T const& msg) const noexcept;
+private:
+    Logger* logger;
+    LogLevel logLevel;
+    bool enabled;
+};
+inline int LevelLogger::append(StringView const& msg) noexcept
 {
-    this->append(nullptr, nullptr, -1, msg, LogLevel::Debu);
-    return *this;
+    if (!this->enabled) {
+        return 0;
+    }
+    return this->logger->append(StringView(), nullptr, -1, msg,
+        this->logLevel);
 }
-template<uint32_t sz> Logger&
-Logger::d(std::string const& name, char const(&msg)[sz]) noexcept
+inline int LevelLogger::append(StringView const& name, char const* const file,
+    int const line, StringView const& msg) noexcept
 {
-    this->append(name, nullptr, -1, msg, LogLevel::Debu);
-    return *this;
+    if (!this->enabled) {
+        return 0;
+    }
+    return this->logger->append(name, file, line, msg, this->logLevel);
+}
+template<typename... Args>
+inline int LevelLogger::format(StringView const& name,
+    FormatString<sizeof...(Args)> const fmt,
+    Args const&... args) noexcept
+{
+    if (!this->enabled) {
+        return 0;
+    }
+    return this->logger->format(this->logLevel, name, nullptr, -1, fmt,
+        args...);
 }
-// <<
 template<typename T>
-typename std::enable_if<std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::operator<<(T const& msg) noexcept
+inline Logger::StreamRecord LevelLogger::operator<<(T const& msg) const noexcept
 {
-    this->append(nullptr, nullptr, -1, msg, this->logLevel);
-    return *this;
+    Logger::StreamRecord record(this->enabled ? this->logger : nullptr,
+        this->logLevel, false);
+    record << msg;
+    return record;
 }
 template<typename T>
-typename std::enable_if<!std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::operator<<(T const& msg) noexcept
+inline Logger::StreamRecord LevelLogger::operator,(T const& msg) const noexcept
 {
-    std::stringstream ss;
-    ss << msg;
-    this->append(nullptr, nullptr, -1, ss.str(), this->logLevel);
-    return *this;
+    Logger::StreamRecord record(this->enabled ? this->logger : nullptr,
+        this->logLevel, true);
+    record << msg;
+    return record;
 }
-template<uint32_t sz> Logger&
-Logger::operator<<(char const(&msg)[sz]) noexcept
+//--
+inline LevelLogger Logger::getLogger(LogLevel const& logLevel,
+    std::string const& path, Outputs const& outputs) noexcept
 {
-    this->append(nullptr, nullptr, -1, msg, this->logLevel);
-    return *this;
+    return Logger::getLevel(logLevel, path, outputs);
 }
-template<typename T>
-typename std::enable_if<std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::operator,(T const& msg) noexcept
+inline LevelLogger Logger::getLevel(LogLevel const& logLevel,
+    std::string const& path, Outputs const& outputs) noexcept
 {
-    this->append(msg, this->logLevel);
-    return *this;
+    return LevelLogger(Logger::getLogger(path, outputs), logLevel);
 }
-template<typename T>
-typename std::enable_if<!std::is_same<std::string,typename std::decay<T>::type>::value, Logger>::type&
-Logger::operator,(T const& msg) noexcept
+inline LevelLogger Logger::getFatal(std::string const& path, Outputs const& outputs) noexcept
 {
-    std::stringstream ss;
-    ss << msg;
-    this->append(ss.str(), this->logLevel);
-    return *this;
+    return Logger::getLevel(LogLevel::Fata, path, outputs);
 }
-template<uint32_t sz> Logger&
-Logger::operator,(char const(&msg)[sz]) noexcept
+inline LevelLogger Logger::getError(std::string const& path, Outputs const& outputs) noexcept
 {
-    this->append(msg, this->logLevel);
-    return *this;
+    return Logger::getLevel(LogLevel::Erro, path, outputs);
+}
+inline LevelLogger Logger::getWarning(std::string const& path, Outputs const& outputs) noexcept
+{
+    return Logger::getLevel(LogLevel::Warn, path, outputs);
+}
+inline LevelLogger Logger::getNote(std::string const& path, Outputs const& outputs) noexcept
+{
+    return Logger::getLevel(LogLevel::Note, path, outputs);
+}
+inline LevelLogger Logger::getInfo(std::string const& path, Outputs const& outputs) noexcept
+{
+    return Logger::getLevel(LogLevel::Info, path, outputs);
+}
+inline LevelLogger Logger::getTrace(std::string const& path, Outputs const& outputs) noexcept
+{
+    return Logger::getLevel(LogLevel::Trac, path, outputs);
+}
+inline LevelLogger Logger::getDebug(std::string const& path, Outputs const& outputs) noexcept
+{
+    return Logger::getLevel(LogLevel::Debu, path, outputs);
+}
+inline LevelLogger Logger::getDetail(std::string const& path, Outputs const& outputs) noexcept
+{
+    return Logger::getLevel(LogLevel::Deta, path, outputs);
 }
 //---------------
 }//namespace log
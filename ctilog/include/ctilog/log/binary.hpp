@@ -0,0 +1,212 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file ctilog/log/binary.hpp
+ * Binary deferred-formatting records, written by Logger::startBinary mode
+ * and rendered to text offline by ctilog-decode
+ *
+ * File layout, integers in host (little) endian:
+ * - header: kBinaryMagic
+ * - format: 'F' u32 id, u8 level, i32 line, then name, file, fmt and arg
+ *   types each as u16 len + bytes; written once per file before the first
+ *   record using it
+ * - record: 'R' u32 id, u64 idx, u64 tid, i64 sec, u32 nsec, u32 args len,
+ *   args
+ *
+ * Args per type: 'b' 'c' 1 byte, 'i' 'I' 'f' 4 bytes, 'l' 'L' 'p' 'd' 8
+ * bytes, 's' u32 len + bytes. Msg is fmt with each "{}" replaced by next arg
+ * ("{{" and "}}" for braces), args left over appended with a space.
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <iosfwd>
+#include <string>
+#include <type_traits>
+#include "ctilog/loglevel.hpp"
+#include "ctilog/log/format.hpp"
+namespace cti {
+namespace log
+{
+constexpr char kBinaryMagic[8] = { 'C', 'T', 'I', 'L', 'O', 'G', 'B', '1' };
+constexpr char kBinaryFormatTag = 'F';
+constexpr char kBinaryRecordTag = 'R';
+/// Record header bytes after tag: id idx tid sec nsec args len
+constexpr uint32_t kBinaryRecordHeadLen = 4 + 8 + 8 + 8 + 4 + 4;
+/**
+ * @struct BinaryFormat
+ * Static format descriptor of one callsite, id taken at first use
+ * @note Constant initialized when name is a constexpr char array
+ */
+struct BinaryFormat {
+    constexpr BinaryFormat(char const* const name, char const* const file,
+        int const line, LogLevel const level, char const* const fmt) noexcept:
+        name(name), file(file), line(line), level(level), fmt(fmt) {}
+    BinaryFormat(BinaryFormat const&) = delete;
+    BinaryFormat& operator=(BinaryFormat const&) = delete;
+    /// Id unique in process, > 0
+    inline uint32_t getId() const noexcept;
+    char const* const name;
+    char const* const file;
+    int const line;
+    LogLevel const level;
+    char const* const fmt;
+private:
+    uint32_t registerId() const noexcept;
+    mutable std::atomic<uint32_t> id{ 0 };
+};
+inline uint32_t BinaryFormat::getId() const noexcept
+{
+    uint32_t const i = this->id.load(std::memory_order_acquire);
+    return i ? i : this->registerId();
+}
+/**
+ * @struct BinaryArg
+ * Type code and encoding of one arg type, not defined for unsupported types
+ */
+template<typename T, typename Enable = void>
+struct BinaryArg;
+template<>
+struct BinaryArg<bool> {
+    static constexpr char kType = 'b';
+    static inline size_t size(bool const) noexcept { return 1; }
+    static inline char* put(char* const p, bool const v) noexcept {
+        *p = v ? 1 : 0;
+        return p + 1;
+    }
+};
+template<>
+struct BinaryArg<char> {
+    static constexpr char kType = 'c';
+    static inline size_t size(char const) noexcept { return 1; }
+    static inline char* put(char* const p, char const v) noexcept {
+        *p = v;
+        return p + 1;
+    }
+};
+/// Fixed size value stored as Wire
+template<typename T, typename Wire, char type>
+struct BinaryFixedArg {
+    static constexpr char kType = type;
+    static inline size_t size(T const) noexcept { return sizeof(Wire); }
+    static inline char* put(char* const p, T const v) noexcept {
+        Wire const w = static_cast<Wire>(v);
+        ::memcpy(p, &w, sizeof(w));
+        return p + sizeof(w);
+    }
+};
+template<typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_integral<T>::value &&
+    !std::is_same<T, bool>::value && !std::is_same<T, char>::value>::type>:
+    BinaryFixedArg<T,
+        typename std::conditional<std::is_signed<T>::value,
+            typename std::conditional<(sizeof(T) <= 4), int32_t, int64_t>::type,
+            typename std::conditional<(sizeof(T) <= 4), uint32_t, uint64_t>::type
+        >::type,
+        std::is_signed<T>::value ? (sizeof(T) <= 4 ? 'i' : 'l') :
+            (sizeof(T) <= 4 ? 'I' : 'L')> {};
+template<typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_enum<T>::value>::type>:
+    BinaryFixedArg<T, int64_t, 'l'> {};
+/// float kept as float so it renders with float shortest digits
+template<>
+struct BinaryArg<float>: BinaryFixedArg<float, float, 'f'> {};
+template<typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_floating_point<T>::value &&
+    !std::is_same<T, float>::value>::type>: BinaryFixedArg<T, double, 'd'> {};
+template<typename T>
+struct BinaryArg<T*, typename std::enable_if<!std::is_same<
+    typename std::remove_cv<T>::type, char>::value>::type> {
+    static constexpr char kType = 'p';
+    static inline size_t size(T const* const) noexcept { return 8; }
+    static inline char* put(char* const p, T const* const v) noexcept {
+        uint64_t const w = uint64_t(uintptr_t(v));
+        ::memcpy(p, &w, sizeof(w));
+        return p + sizeof(w);
+    }
+};
+/// String stored as u32 len + bytes, nullptr as "(null)"
+struct BinaryStringArg {
+    static constexpr char kType = 's';
+    static inline size_t size(char const* const v) noexcept {
+        return 4 + (v ? ::strlen(v) : 6);
+    }
+    static inline size_t size(std::string const& v) noexcept {
+        return 4 + v.length();
+    }
+    static inline char* put(char* const p, char const* const v) noexcept {
+        return BinaryStringArg::put(p, v ? v : "(null)", v ? ::strlen(v) : 6);
+    }
+    static inline char* put(char* const p, std::string const& v) noexcept {
+        return BinaryStringArg::put(p, v.data(), v.length());
+    }
+    static inline char* put(char* const p, char const* const v,
+        size_t const len) noexcept {
+        uint32_t const l = uint32_t(len);
+        ::memcpy(p, &l, sizeof(l));
+        ::memcpy(p + sizeof(l), v, len);
+        return p + sizeof(l) + len;
+    }
+};
+template<> struct BinaryArg<char const*>: BinaryStringArg {};
+template<> struct BinaryArg<char*>: BinaryStringArg {};
+template<> struct BinaryArg<std::string>: BinaryStringArg {};
+/// Type codes of Args, '\0' ended
+template<typename... Args>
+struct BinaryTypes {
+    static constexpr char value[sizeof...(Args) + 1] = {
+        BinaryArg<typename std::decay<Args>::type>::kType..., '\0' };
+};
+template<typename... Args>
+constexpr char BinaryTypes<Args...>::value[sizeof...(Args) + 1];
+/// Encoded bytes of args
+inline size_t BinarySize() noexcept
+{
+    return 0;
+}
+template<typename T, typename... Rest>
+inline size_t BinarySize(T const& v, Rest const&... rest) noexcept
+{
+    return BinaryArg<typename std::decay<T>::type>::size(v) +
+        BinarySize(rest...);
+}
+/// Encode args to @a p, @return end
+inline char* BinaryPut(char* const p) noexcept
+{
+    return p;
+}
+template<typename T, typename... Rest>
+inline char* BinaryPut(char* const p, T const& v, Rest const&... rest) noexcept
+{
+    return BinaryPut(BinaryArg<typename std::decay<T>::type>::put(p, v),
+        rest...);
+}
+/**
+ * Render msg of @a fmt with encoded @a args of @a types, appended to @a out
+ * @return false when args shorter than types say
+ */
+extern bool RenderBinaryArgs(char const* const fmt, char const* const types,
+    char const* const args, size_t const argsLen, std::string& out) noexcept;
+/// RenderBinaryArgs to a reused buffer, no allocation once it has grown
+extern bool RenderBinaryArgs(char const* const fmt, char const* const types,
+    char const* const args, size_t const argsLen, FormatBuffer& out) noexcept;
+/**
+ * Render a binary log to text lines as Logger writes them
+ * @param hasTid output thread id like Logger::enableTid(true)
+ * @return records rendered, or -errno (-EBADMSG bad or cut file)
+ */
+extern int64_t DecodeBinaryLog(std::istream& in, std::ostream& out,
+    bool const hasTid = false) noexcept;
+}//namespace log
+}//namespace cti
@@ -0,0 +1,154 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+namespace cti {
+namespace log
+{
+constexpr uint32_t kCacheLineSize = 64;
+/**
+ * @struct BoundedQueue
+ * Bounded lock-free multi-producer multi-consumer queue (Vyukov)
+ *
+ * Elements live in preallocated cells and are filled/consumed in place, so
+ * a T holding std::string keeps its capacity and steady-state push/pop does
+ * not allocate.
+ * @tparam T element type, must be default constructible
+ */
+template<typename T>
+struct BoundedQueue {
+    /// @param capacity rounded up to power of 2, min 2
+    explicit BoundedQueue(uint32_t const capacity);
+    BoundedQueue(BoundedQueue const&) = delete;
+    BoundedQueue& operator=(BoundedQueue const&) = delete;
+    /**
+     * Try push one element
+     * @param fill void(T&), fill the cell in place
+     * @return false when full
+     */
+    template<typename F> bool tryPush(F&& fill) noexcept;
+    /**
+     * Try pop one element
+     * @param consume void(T&), consume the cell in place
+     * @return false when empty
+     */
+    template<typename F> bool tryPop(F&& consume) noexcept;
+    /// @note Only a hint under concurrency
+    inline bool empty() const noexcept;
+    /// Total elements ever claimed by push
+    inline uint64_t pushed() const noexcept;
+    inline uint32_t capacity() const noexcept { return this->mask + 1; }
+private:
+    struct Cell {
+        std::atomic<uint64_t> seq;
+        T data;
+    };
+    static inline uint32_t roundUp(uint32_t v) noexcept;
+    uint32_t const mask;
+    std::unique_ptr<Cell[]> cells;
+    char pad0[kCacheLineSize];
+    std::atomic<uint64_t> enqueuePos{ 0 };
+    char pad1[kCacheLineSize - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> dequeuePos{ 0 };
+    char pad2[kCacheLineSize - sizeof(std::atomic<uint64_t>)];
+};
+template<typename T>
+inline uint32_t BoundedQueue<T>::roundUp(uint32_t v) noexcept
+{
+    if (v < 2) {
+        return 2;
+    }
+    --v;
+    v |= v >> 1;
+    v |= v >> 2;
+    v |= v >> 4;
+    v |= v >> 8;
+    v |= v >> 16;
+    return v + 1;
+}
+template<typename T>
+BoundedQueue<T>::BoundedQueue(uint32_t const capacity):
+    mask(BoundedQueue::roundUp(capacity) - 1),
+    cells(new Cell[BoundedQueue::roundUp(capacity)])
+{
+    for (uint32_t i = 0; i <= this->mask; ++i) {
+        this->cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+template<typename T>
+template<typename F>
+bool BoundedQueue<T>::tryPush(F&& fill) noexcept
+{
+    Cell* cell;
+    uint64_t pos = this->enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        cell = &this->cells[pos & this->mask];
+        uint64_t const seq = cell->seq.load(std::memory_order_acquire);
+        int64_t const dif = int64_t(seq) - int64_t(pos);
+        if (0 == dif) {
+            if (this->enqueuePos.compare_exchange_weak(pos, pos + 1,
+                std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            // Full
+            return false;
+        } else {
+            pos = this->enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    fill(cell->data);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+template<typename T>
+template<typename F>
+bool BoundedQueue<T>::tryPop(F&& consume) noexcept
+{
+    Cell* cell;
+    uint64_t pos = this->dequeuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        cell = &this->cells[pos & this->mask];
+        uint64_t const seq = cell->seq.load(std::memory_order_acquire);
+        int64_t const dif = int64_t(seq) - int64_t(pos + 1);
+        if (0 == dif) {
+            if (this->dequeuePos.compare_exchange_weak(pos, pos + 1,
+                std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            // Empty
+            return false;
+        } else {
+            pos = this->dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+    consume(cell->data);
+    cell->seq.store(pos + this->mask + 1, std::memory_order_release);
+    return true;
+}
+template<typename T>
+inline bool BoundedQueue<T>::empty() const noexcept
+{
+    return this->dequeuePos.load(std::memory_order_acquire) >=
+        this->enqueuePos.load(std::memory_order_acquire);
+}
+template<typename T>
+inline uint64_t BoundedQueue<T>::pushed() const noexcept
+{
+    return this->enqueuePos.load(std::memory_order_acquire);
+}
+}//namespace log
+}//namespace cti
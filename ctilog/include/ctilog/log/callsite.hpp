@@ -0,0 +1,129 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file ctilog/log/callsite.hpp
+ * Static descriptor of one loghelper macro callsite
+ *
+ * Each macro makes one static Callsite of kN, basename of __FILE__ (found at
+ * compile time), __LINE__, __func__ and level, and hands the Logger a
+ * pointer to it. Its " (file+line)" suffix is rendered once on first use,
+ * when the callsite is also added to the registry of GetSeenCallsites():
+ * a callsite that never wrote a record, as one below the logger's level,
+ * is not in it.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ctilog/loglevel.hpp"
+#include "ctilog/log/stringview.hpp"
+namespace cti {
+namespace log
+{
+constexpr size_t CallsiteMax(size_t const a, size_t const b) noexcept
+{
+    return a > b ? a : b;
+}
+/**
+ * Offset after last '/' in @a path [lo, hi), 0 when none
+ * @note Halves the range, so C++11 constexpr recursion depth is log2 of
+ * path length rather than the length
+ */
+constexpr size_t CallsiteBaseOffset(char const* const path, size_t const lo,
+    size_t const hi) noexcept
+{
+    return hi <= lo ? 0 :
+        hi - lo == 1 ? ('/' == path[lo] ? lo + 1 : 0) :
+        CallsiteMax(CallsiteBaseOffset(path, lo + (hi - lo) / 2, hi),
+            CallsiteBaseOffset(path, lo, lo + (hi - lo) / 2));
+}
+/// Basename of literal @a path such as __FILE__, at compile time
+template<size_t N>
+constexpr char const* CallsiteBasename(char const (&path)[N]) noexcept
+{
+    return path + CallsiteBaseOffset(path, 0, N - 1);
+}
+/// Name of a loghelper kN, which is a char const* or std::string
+constexpr char const* CallsiteName(char const* const name) noexcept
+{
+    return name;
+}
+/// @note @a name should live as long as the program, as kN at file scope
+inline char const* CallsiteName(std::string const& name) noexcept
+{
+    return name.c_str();
+}
+/**
+ * @struct Callsite
+ * Name, file basename, line, function and level of a callsite
+ * @note Constant initialized when name is a constexpr char const*, never
+ * freed, records in the async queue keep a pointer to it
+ */
+struct Callsite {
+    constexpr Callsite(char const* const name, char const* const file,
+        int const line, char const* const func, LogLevel const level)
+        noexcept: name(name), file(file), line(line), func(func),
+        level(level) {}
+    Callsite(Callsite const&) = delete;
+    Callsite& operator=(Callsite const&) = delete;
+    /// name, nullptr data when none
+    inline StringView getName() const noexcept;
+    /// " (file+line)", rendered at first use
+    inline StringView getSuffix() const noexcept;
+    char const* const name;
+    char const* const file;
+    int const line;
+    char const* const func;
+    LogLevel const level;
+private:
+    friend std::vector<Callsite const*> GetSeenCallsites() noexcept;
+    /// Lengths and suffix, immutable once published
+    struct Text {
+        uint32_t nameLen;
+        uint32_t suffixLen;
+        char suffix[1];
+    };
+    inline Text const* getText() const noexcept;
+    /// Render text and add to registry, once
+    Text const* render() const noexcept;
+    mutable std::atomic<Text const*> text{ nullptr };
+    /// Next in registry, set before published
+    mutable Callsite const* next{ nullptr };
+};
+inline Callsite::Text const* Callsite::getText() const noexcept
+{
+    Text const* const t = this->text.load(std::memory_order_acquire);
+    return t ? t : this->render();
+}
+inline StringView Callsite::getName() const noexcept
+{
+    Text const* const t = this->getText();
+    // No text only when out of memory
+    return t ? StringView(this->name, t->nameLen) : StringView(this->name);
+}
+inline StringView Callsite::getSuffix() const noexcept
+{
+    Text const* const t = this->getText();
+    return t ? StringView(t->suffix, t->suffixLen) : StringView("", 0);
+}
+/**
+ * Callsites seen so far: those that wrote a record in process, newest first
+ * @note Not every log statement of the program; one not yet run, or only
+ * run below the logger's level, is missing
+ */
+extern std::vector<Callsite const*> GetSeenCallsites() noexcept;
+}//namespace log
+}//namespace cti
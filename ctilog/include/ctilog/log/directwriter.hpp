@@ -0,0 +1,95 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file ctilog/log/directwriter.hpp
+ * File writer by O_DIRECT (PosixFileOpenFlag::Direct), see
+ * Logger::startDirect
+ *
+ * Data is copied into one buffer aligned to kDirectAlign, written at an
+ * aligned file offset when full, so log data does not stay in page cache.
+ * The last partial block is written padded with zeros then the file is
+ * truncated to its real end; that block stays in buffer and is written
+ * again whole by the next write. A file not ending at a block boundary has
+ * its last block read back when attached.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+namespace cti {
+namespace log
+{
+/// Buffer address, file offset and write size are multiples of it
+constexpr uint32_t kDirectAlign = 4096;
+constexpr uint32_t kMinDirectBufferBytes = 16 * kDirectAlign;
+constexpr uint32_t kMaxDirectBufferBytes = 64 * 1024 * 1024;
+constexpr uint32_t kDefaultDirectBufferBytes = 1024 * 1024;
+/**
+ * @struct DirectWriter
+ * Appends to one file at a time in aligned blocks
+ * @note Not thread safe, Logger calls it under writemutex
+ */
+struct DirectWriter {
+    DirectWriter() noexcept {}
+    ~DirectWriter() noexcept;
+    DirectWriter(DirectWriter const&) = delete;
+    DirectWriter& operator=(DirectWriter const&) = delete;
+    /**
+     * Allocate buffer of @a bufferBytes, rounded up to kDirectAlign, in
+     * [kMinDirectBufferBytes, kMaxDirectBufferBytes]
+     * @return 0 when success else -ENOMEM
+     */
+    int open(uint32_t const bufferBytes) noexcept;
+    /// Detach and free buffer
+    void close() noexcept;
+    /**
+     * Write @a path from its end, by an O_DIRECT fd of its own
+     * @return 0 when success, -EINVAL when file system has no O_DIRECT
+     * (e.g. tmpfs before Linux 6.6), else -errno
+     */
+    int attach(std::string const& path) noexcept;
+    /// Flush and close file
+    void detach() noexcept;
+    inline bool isAttached() const noexcept { return this->fd >= 0; }
+    /// Copy @a len bytes, write buffer when full, @return 0 or -errno
+    int write(char const* data, size_t len) noexcept;
+    /**
+     * Write data not written, last block padded, file truncated to its end
+     * @return 0 or -errno
+     */
+    int flush() noexcept;
+    /**
+     * In signal handler: O_DIRECT cleared on fd, buffer [0, len) as seen
+     * now written at base by pwrite, buffer and file size not changed
+     * @note Async-signal-safe; a thread writing meanwhile may leave the
+     * last bytes stale, best effort
+     */
+    void crashFlush() noexcept;
+private:
+    /**
+     * Write @a bytes of buffer at base, @return 0 or -errno
+     * @note Aligned while fd is O_DIRECT
+     */
+    int writeBlocks(size_t const bytes) noexcept;
+    int fd{ -1 };
+    char* buffer{ nullptr };
+    uint32_t bufferBytes{ 0 };
+    /// File offset of buffer, aligned
+    uint64_t base{ 0 };
+    /// Bytes in buffer, from base
+    uint32_t len{ 0 };
+    /// Data copied since last write of buffer
+    bool dirty{ false };
+};
+}//namespace log
+}//namespace cti
@@ -0,0 +1,48 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file ctilog/log/epoch.hpp
+ * Epoch based reclamation for read-mostly shared data
+ *
+ * - Readers pin the current thread with EpochGuard while they use shared
+ *   data, pin only writes a slot owned by the thread
+ * - Writers publish a new version, then EpochRetire the old one, it is
+ *   freed when every thread pinned before the retire has unpinned
+ */
+#pragma once
+#include <stdint.h>
+#include <functional>
+namespace cti {
+namespace log
+{
+/// Pin current thread, nesting allowed
+extern void EpochPin() noexcept;
+/// Unpin current thread, pairs with EpochPin
+extern void EpochUnpin() noexcept;
+/**
+ * Free @a deleter's data when all threads pinned now have unpinned
+ * @note Call after the data unreachable for new readers, may run deleters
+ * of data retired earlier in current thread
+ */
+extern void EpochRetire(std::function<void()> const& deleter) noexcept;
+/// Run deleters whose grace period passed
+extern void EpochReclaim() noexcept;
+/// Auto pin guard
+struct EpochGuard {
+    EpochGuard() noexcept { EpochPin(); }
+    ~EpochGuard() { EpochUnpin(); }
+    EpochGuard(EpochGuard const&) = delete;
+    EpochGuard& operator=(EpochGuard const&) = delete;
+};
+}//namespace log
+}//namespace cti
@@ -0,0 +1,93 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file ctilog/log/flightrecorder.hpp
+ * In-memory ring of records filtered out by log level, see
+ * Logger::startFlightRecorder
+ *
+ * Fixed size slots, a writer takes a ticket by one fetch_add and owns its
+ * slot by one CAS, so capture never locks, allocates or formats a header.
+ * A slot still owned (writer lapped by the ring, or drain reading it) drops
+ * the record. Text longer than a slot is cut.
+ */
+#pragma once
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include "ctilog/loglevel.hpp"
+#include "ctilog/log/stringview.hpp"
+namespace cti {
+namespace log
+{
+/// Bytes of one slot, header included
+constexpr uint32_t kFlightSlotSize = 256;
+constexpr size_t kDefaultFlightRecorderSize = 1024 * 1024;
+/**
+ * @struct FlightEntry
+ * One captured record, name then "msg (file+line)" in text
+ */
+struct FlightEntry {
+    /// Ticket + 1, 0 when empty
+    uint64_t ticket;
+    int64_t sec;
+    uint32_t nsec;
+    uint8_t level;
+    uint8_t nameLen;
+    uint16_t textLen;
+    uint64_t tid;
+    char text[kFlightSlotSize - 40];
+};
+/**
+ * @struct FlightRecorder
+ * Lock-free multi-producer ring of FlightEntry
+ */
+struct FlightRecorder {
+    /// @param bytes memory budget, slots rounded down to power of 2, min 16
+    explicit FlightRecorder(size_t const bytes) noexcept;
+    FlightRecorder(FlightRecorder const&) = delete;
+    FlightRecorder& operator=(FlightRecorder const&) = delete;
+    /// False when out of memory
+    inline bool valid() const noexcept { return bool(this->slots); }
+    /// Keep one record, @a name cut to 255 bytes, text to the slot
+    void capture(LogLevel const& level, StringView const& name,
+        StringView const& msg, StringView const& suffix) noexcept;
+    /**
+     * Call @a f on entries captured since last drain, oldest first
+     * @return entries passed to @a f
+     * @note One drain at a time, caller serializes
+     */
+    size_t drain(std::function<void(FlightEntry const&)> const& f) noexcept;
+    /// Records dropped as their slot was owned
+    inline uint64_t getDropped() const noexcept {
+        return this->dropped.load(std::memory_order_relaxed);
+    }
+    inline size_t capacity() const noexcept { return this->mask + 1; }
+private:
+    struct Slot {
+        /// Even when free, odd when owned by a writer or drain
+        std::atomic<uint64_t> seq;
+        FlightEntry entry;
+    };
+    size_t mask{ 0 };
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<uint64_t> head{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    /// Tickets below it already drained, used by drain only
+    uint64_t drained{ 0 };
+};
+}//namespace log
+}//namespace cti
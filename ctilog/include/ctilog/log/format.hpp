@@ -0,0 +1,304 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file ctilog/log/format.hpp
+ * "{}" format, args formatted directly into a reused per-thread buffer, and
+ * the number formatting used for records and their args
+ *
+ * Rules shared with binary records: each "{}" is replaced by next arg, "{{"
+ * and "}}" are braces, args left over appended with a space, "{}" left as is
+ * when args run out. FormatArgCount checks a literal at compile time, used
+ * by loghelper LogFmt/LogBin with static_assert, and by FormatString when
+ * the compiler has consteval (C++20).
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+namespace cti {
+namespace log
+{
+/**
+ * FormatArgCount scan state after @a c: state is count * 3 + brace waiting
+ * for its pair (0 none, 1 '{', 2 '}'), -1 when a brace is not paired
+ */
+constexpr int FormatScanChar(int const s, char const c) noexcept
+{
+    return s < 0 ? -1 :
+        1 == s % 3 ? ('{' == c ? s - 1 : '}' == c ? s + 2 : -1) :
+        2 == s % 3 ? ('}' == c ? s - 2 : -1) :
+        '{' == c ? s + 1 : '}' == c ? s + 2 : s;
+}
+/**
+ * Scan state after @a f [lo, hi) from state @a s
+ * @note Halves the range, so C++11 constexpr recursion depth is log2 of
+ * format length rather than the length
+ */
+constexpr int FormatScan(char const* const f, size_t const lo,
+    size_t const hi, int const s) noexcept
+{
+    return hi <= lo ? s :
+        hi - lo == 1 ? FormatScanChar(s, f[lo]) :
+        FormatScan(f, lo + (hi - lo) / 2, hi,
+            FormatScan(f, lo, lo + (hi - lo) / 2, s));
+}
+/// Count of "{}" from scan state @a s at end, -1 when a brace is not paired
+constexpr int FormatScanCount(int const s) noexcept
+{
+    return s < 0 || s % 3 ? -1 : s / 3;
+}
+/// Count "{}" in literal @a f, -1 when a brace is not paired
+template<size_t N>
+constexpr int FormatArgCount(char const (&f)[N]) noexcept
+{
+    return FormatScanCount(FormatScan(f, 0, N - 1, 0));
+}
+/**
+ * @struct RuntimeFormat
+ * A "{}" format not known at compile time, never checked: pass
+ * RuntimeFormat(fmt) where a FormatString is taken
+ */
+struct RuntimeFormat {
+    explicit constexpr RuntimeFormat(char const* const f) noexcept: str(f) {}
+    char const* str;
+};
+/// Not defined: called by a consteval FormatString only when check fails
+void FormatStringUnpairedBrace() noexcept;
+void FormatStringArgCountNotEqual() noexcept;
+/**
+ * @struct FormatString
+ * "{}" format of @a Count args taken by Logger::format, info etc.: a
+ * literal or a RuntimeFormat
+ * @note Literal checked at compile time only when compiled as C++20 or
+ * later (consteval), a wrong one is an error calling FormatStringXxx; in
+ * C++11/14/17 it is not checked, use loghelper LogFmt for the check
+ */
+template<size_t Count>
+struct FormatString {
+#if defined __cpp_consteval
+    template<size_t N>
+    consteval FormatString(char const (&f)[N]) noexcept: str(f) {
+        if (FormatArgCount(f) < 0) {
+            FormatStringUnpairedBrace();
+        } else if (size_t(FormatArgCount(f)) != Count) {
+            FormatStringArgCountNotEqual();
+        }
+    }
+#else
+    template<size_t N>
+    constexpr FormatString(char const (&f)[N]) noexcept: str(f) {}
+#endif
+    constexpr FormatString(RuntimeFormat const& f) noexcept: str(f.str) {}
+    char const* str;
+};
+/// Max chars of FormatU64 and FormatI64
+constexpr size_t kFormatIntMaxLen = 20;
+/// Max chars of FormatDouble and FormatFloat, "-1.2345678901234567e-308"
+constexpr size_t kFormatFloatMaxLen = 24;
+/**
+ * Decimal of @a v to @a buf, two digits per step from a table
+ * @return chars written, no '\0'
+ */
+extern size_t FormatU64(char* const buf, uint64_t v) noexcept;
+extern size_t FormatI64(char* const buf, int64_t const v) noexcept;
+/**
+ * Shortest (Grisu2, in rare cases one digit longer) decimal of @a v that
+ * reads back to the same value, no locale
+ *
+ * Fixed notation while the decimal point is within 17 digits and value is
+ * >= 0.0001 (as %g), else like 1.5e-07 or 1e+300; "nan", "inf", "-inf", "-0"
+ * @return chars written, no '\0'
+ */
+extern size_t FormatDouble(char* const buf, double const v) noexcept;
+/// FormatDouble with float precision, 0.1f is "0.1"
+extern size_t FormatFloat(char* const buf, float const v) noexcept;
+/// sizeof(FormatArgCounter(args...)) - 1 is count of args, unevaluated only
+template<typename... Args>
+char (&FormatArgCounter(Args const&...))[sizeof...(Args) + 1];
+/**
+ * @struct FormatBuffer
+ * Growing char buffer, keeps its capacity between records
+ */
+struct FormatBuffer {
+    FormatBuffer() noexcept {}
+    FormatBuffer(FormatBuffer const&) = delete;
+    FormatBuffer& operator=(FormatBuffer const&) = delete;
+    inline void clear() noexcept { this->len = 0; }
+    inline size_t size() const noexcept { return this->len; }
+    inline char const* data() const noexcept { return this->buf.get(); }
+    /// Make room for @a n more bytes, @return where to write
+    inline char* reserve(size_t const n) noexcept {
+        if (this->len + n > this->cap) {
+            this->grow(this->len + n);
+        }
+        return this->buf.get() + this->len;
+    }
+    inline void commit(size_t const n) noexcept { this->len += n; }
+    inline void append(char const c) noexcept {
+        *this->reserve(1) = c;
+        ++this->len;
+    }
+    inline void append(char const* const s, size_t const n) noexcept {
+        ::memcpy(this->reserve(n), s, n);
+        this->len += n;
+    }
+    void appendU64(uint64_t const v) noexcept;
+    void appendI64(int64_t const v) noexcept;
+    void appendDouble(double const v) noexcept;
+    void appendFloat(float const v) noexcept;
+    void appendPointer(void const* const v) noexcept;
+    /// In use by a format on this thread, nested format takes another
+    bool busy{ false };
+private:
+    void grow(size_t const need) noexcept;
+    std::unique_ptr<char[]> buf;
+    size_t len{ 0 };
+    size_t cap{ 0 };
+};
+/// Buffer of current thread
+extern FormatBuffer& ThreadFormatBuffer() noexcept;
+/**
+ * @struct ScopedFormatBuffer
+ * Takes the thread's FormatBuffer cleared for one record, or a new one when
+ * it is in use (an arg's << logs again)
+ */
+struct ScopedFormatBuffer {
+    inline ScopedFormatBuffer() noexcept {
+        FormatBuffer& threadBuffer = ThreadFormatBuffer();
+        if (threadBuffer.busy) {
+            this->nested.reset(new FormatBuffer);
+            this->b = this->nested.get();
+        } else {
+            this->b = &threadBuffer;
+        }
+        this->b->busy = true;
+        this->b->clear();
+    }
+    inline ~ScopedFormatBuffer() noexcept { this->b->busy = false; }
+    ScopedFormatBuffer(ScopedFormatBuffer const&) = delete;
+    ScopedFormatBuffer& operator=(ScopedFormatBuffer const&) = delete;
+    inline FormatBuffer& buffer() noexcept { return *this->b; }
+private:
+    FormatBuffer* b;
+    std::unique_ptr<FormatBuffer> nested;
+};
+/**
+ * Copy text of @a f until next "{}" with escapes done
+ * @return after the "{}", nullptr when none left or @a f is nullptr
+ */
+extern char const* FormatCopyText(FormatBuffer& b, char const* f) noexcept;
+/**
+ * @struct FormatArg
+ * How one arg type is formatted, std::ostream << for types not listed
+ */
+template<typename T, typename Enable = void>
+struct FormatArg {
+    static inline void put(FormatBuffer& b, T const& v) noexcept {
+        std::ostringstream ss;
+        ss << v;
+        std::string const s = ss.str();
+        b.append(s.data(), s.length());
+    }
+};
+template<>
+struct FormatArg<bool> {
+    // Same as default std::ostream
+    static inline void put(FormatBuffer& b, bool const v) noexcept {
+        b.append(v ? '1' : '0');
+    }
+};
+template<>
+struct FormatArg<char> {
+    static inline void put(FormatBuffer& b, char const v) noexcept {
+        b.append(v);
+    }
+};
+template<typename T>
+struct FormatArg<T, typename std::enable_if<std::is_integral<T>::value &&
+    !std::is_same<T, bool>::value && !std::is_same<T, char>::value>::type> {
+    static inline void put(FormatBuffer& b, T const v) noexcept {
+        if (std::is_signed<T>::value) {
+            b.appendI64(int64_t(v));
+        } else {
+            b.appendU64(uint64_t(v));
+        }
+    }
+};
+template<typename T>
+struct FormatArg<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+    static inline void put(FormatBuffer& b, T const v) noexcept {
+        b.appendI64(int64_t(v));
+    }
+};
+template<>
+struct FormatArg<float> {
+    static inline void put(FormatBuffer& b, float const v) noexcept {
+        b.appendFloat(v);
+    }
+};
+template<>
+struct FormatArg<double> {
+    static inline void put(FormatBuffer& b, double const v) noexcept {
+        b.appendDouble(v);
+    }
+};
+template<typename T>
+struct FormatArg<T*, typename std::enable_if<!std::is_same<
+    typename std::remove_cv<T>::type, char>::value>::type> {
+    static inline void put(FormatBuffer& b, T const* const v) noexcept {
+        b.appendPointer(v);
+    }
+};
+template<>
+struct FormatArg<char const*> {
+    static inline void put(FormatBuffer& b, char const* const v) noexcept {
+        if (v) {
+            b.append(v, ::strlen(v));
+        } else {
+            b.append("(null)", 6);
+        }
+    }
+};
+template<> struct FormatArg<char*>: FormatArg<char const*> {};
+template<>
+struct FormatArg<std::string> {
+    static inline void put(FormatBuffer& b, std::string const& v) noexcept {
+        b.append(v.data(), v.length());
+    }
+};
+/// Format @a f with args into @a b
+inline void FormatTo(FormatBuffer& b, char const* const f) noexcept
+{
+    // "{}" without arg left as is
+    char const* p = f;
+    while ((p = FormatCopyText(b, p))) {
+        b.append("{}", 2);
+    }
+}
+template<typename T, typename... Rest>
+inline void FormatTo(FormatBuffer& b, char const* const f, T const& v,
+    Rest const&... rest) noexcept
+{
+    char const* const next = f ? FormatCopyText(b, f) : nullptr;
+    if (!next) {
+        // Arg without "{}"
+        b.append(' ');
+    }
+    FormatArg<typename std::decay<T>::type>::put(b, v);
+    FormatTo(b, next, rest...);
+}
+}//namespace log
+}//namespace cti
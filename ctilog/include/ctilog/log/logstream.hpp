@@ -0,0 +1,103 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file ctilog/log/logstream.hpp
+ * Per-thread reusable std::ostream for msg of loghelper macros and the
+ * Logger stream style methods, instead of a std::stringstream per record
+ *
+ * Writes go to an inline arena, spilling to a heap buffer kept by the thread
+ * when a record is longer, so steady state neither allocates nor copies the
+ * locale. The msg is handed to Logger::append as a StringView.
+ */
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include "ctilog/log/stringview.hpp"
+namespace cti {
+namespace log
+{
+/// Inline arena bytes of a LogStreamBuf
+constexpr size_t kLogStreamArenaSize = 4096;
+/**
+ * @struct LogStreamBuf
+ * streambuf writing to a fixed arena, growing to the heap when full
+ */
+struct LogStreamBuf: public std::streambuf {
+    LogStreamBuf() noexcept;
+    LogStreamBuf(LogStreamBuf const&) = delete;
+    LogStreamBuf& operator=(LogStreamBuf const&) = delete;
+    /// Drop content, capacity kept
+    void reset() noexcept;
+    inline char const* data() const noexcept { return this->pbase(); }
+    inline size_t size() const noexcept {
+        return size_t(this->pptr() - this->pbase());
+    }
+    /// Append without the ostream
+    void append(char const* const s, size_t const n) noexcept;
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(char const* s, std::streamsize n) override;
+private:
+    /// Room for @a n more bytes, false when out of memory
+    bool grow(size_t const n) noexcept;
+    std::unique_ptr<char[]> heap;
+    size_t heapSize{ 0 };
+    char arena[kLogStreamArenaSize];
+};
+/**
+ * @struct LogStream
+ * LogStreamBuf and an ostream over it, see ThreadLogStream
+ */
+struct LogStream {
+    LogStream() noexcept: os(&this->buf) {}
+    LogStream(LogStream const&) = delete;
+    LogStream& operator=(LogStream const&) = delete;
+    /// Empty, default format flags, precision, width and fill, no error
+    void reset() noexcept;
+    LogStreamBuf buf;
+    std::ostream os;
+    /// In use by a record on this thread
+    bool busy{ false };
+};
+/// Stream of current thread
+extern LogStream& ThreadLogStream() noexcept;
+/**
+ * @struct ScopedLogStream
+ * Takes the thread's LogStream reset for one record, or a new one when it
+ * is in use (a << of the record logs again)
+ */
+struct ScopedLogStream {
+    ScopedLogStream() noexcept;
+    /// Takes over the stream of @a other, which then holds none
+    inline ScopedLogStream(ScopedLogStream&& other) noexcept:
+        s(other.s), nested(std::move(other.nested)) {
+        other.s = nullptr;
+    }
+    ~ScopedLogStream() noexcept;
+    ScopedLogStream(ScopedLogStream const&) = delete;
+    ScopedLogStream& operator=(ScopedLogStream const&) = delete;
+    inline std::ostream& stream() noexcept { return this->s->os; }
+    inline char const* data() const noexcept { return this->s->buf.data(); }
+    inline size_t size() const noexcept { return this->s->buf.size(); }
+    inline StringView view() const noexcept {
+        return StringView(this->data(), this->size());
+    }
+private:
+    LogStream* s;
+    std::unique_ptr<LogStream> nested;
+};
+}//namespace log
+}//namespace cti
@@ -0,0 +1,97 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file ctilog/log/mmapring.hpp
+ * Fixed size log file used as a ring, written through a shared mapping, see
+ * Logger::startRing
+ *
+ * File layout, integers in host (little) endian:
+ * - header, kRingHeaderSize bytes: kRingMagic, u64 capacity, u64 head (bytes
+ *   ever reserved, advanced atomically in the mapping)
+ * - data, capacity bytes: frames at head % capacity, wrapping at the end
+ *
+ * A frame is u32 len, u32 check, u64 pos then len bytes, padded to
+ * kRingAlign. pos is the frame's offset counted from the first byte ever
+ * written, stored last, so a frame not finished (writer crashed or lapped)
+ * or overwritten by a newer lap does not match where it lies and is skipped.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+#include <string>
+namespace cti {
+namespace log
+{
+constexpr char kRingMagic[8] = { 'C', 'T', 'I', 'L', 'O', 'G', 'R', '1' };
+/// Header is one page, so data is page aligned
+constexpr uint32_t kRingHeaderSize = 4096;
+/// Frames start at multiples of it, so a frame header never wraps
+constexpr uint32_t kRingAlign = 16;
+constexpr uint32_t kRingFrameHeadLen = 16;
+constexpr size_t kMinRingSize = 64 * 1024;
+/// ReadRing maps the file at once
+constexpr size_t kMaxRingSize = 512 * 1024 * 1024;
+constexpr size_t kDefaultRingSize = 64 * 1024 * 1024;
+/**
+ * @struct MmapRing
+ * Multi-producer writer of a ring file, no syscall per record
+ * @note Kernel writes back the mapping, so records appended survive a crash
+ * of the process, not of the system unless sync()
+ */
+struct MmapRing {
+    MmapRing() noexcept {}
+    ~MmapRing() noexcept;
+    MmapRing(MmapRing const&) = delete;
+    MmapRing& operator=(MmapRing const&) = delete;
+    /**
+     * Open or create @a path of @a bytes data, preallocated and mapped
+     * @param bytes rounded down to kRingAlign, in [kMinRingSize, kMaxRingSize]
+     * @return 0 when success else -errno
+     * @note An existing ring of same size is continued, else recreated
+     */
+    int open(std::string const& path, size_t const bytes) noexcept;
+    void close() noexcept;
+    inline bool isOpen() const noexcept { return this->data; }
+    /**
+     * Copy @a len bytes of @a msg as one frame
+     * @note Async-signal-safe, msg longer than 1/4 capacity is cut
+     */
+    void append(char const* const msg, size_t len) noexcept;
+    /// msync the mapping, @return 0 or -errno
+    int sync() noexcept;
+    inline uint64_t capacity() const noexcept { return this->cap; }
+private:
+    struct Header {
+        char magic[sizeof(kRingMagic)];
+        uint64_t capacity;
+        std::atomic<uint64_t> head;
+    };
+    Header* header{ nullptr };
+    char* data{ nullptr };
+    uint64_t cap{ 0 };
+    size_t mapped{ 0 };
+};
+/**
+ * Read frames of ring file @a path oldest first, by File::traverse
+ * @param f called with each record, valid during the call only
+ * @return records read, or -errno (-EBADMSG not a ring file)
+ * @note Frames not finished or overwritten are skipped, a ring still written
+ * may lose the oldest frames while read
+ */
+extern int64_t ReadRing(std::string const& path,
+    std::function<void(char const* const msg, size_t const len)> const& f)
+    noexcept;
+}//namespace log
+}//namespace cti
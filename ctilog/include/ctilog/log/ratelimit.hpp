@@ -0,0 +1,112 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file ctilog/log/ratelimit.hpp
+ * Per-callsite limiters of loghelper LogEveryN/LogFirstN/LogEveryT/LogRate
+ *
+ * One static limiter per callsite shared by all threads, constant
+ * initialized so no guard. allow() sets @a suppressed to calls skipped
+ * since last allowed one, to be reported on the line it allows.
+ */
+#pragma once
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+namespace cti {
+namespace log
+{
+/// Coarse monotonic ns, vDSO and a few ns
+static inline uint64_t RateLimitNowNs() noexcept
+{
+    timespec tp;
+    if (::clock_gettime(CLOCK_MONOTONIC_COARSE, &tp)) {
+        return 0;
+    }
+    return uint64_t(tp.tv_sec) * 1000000000ull + uint64_t(tp.tv_nsec);
+}
+/// Allow 1st, N+1th, 2N+1th ... call
+struct RateLimitEveryN {
+    constexpr RateLimitEveryN() noexcept {}
+    inline bool allow(uint64_t const n, uint64_t& suppressed) noexcept {
+        uint64_t const c = this->count.fetch_add(1, std::memory_order_relaxed);
+        if (n > 1 && c % n) {
+            return false;
+        }
+        suppressed = (c && n > 1) ? n - 1 : 0;
+        return true;
+    }
+    std::atomic<uint64_t> count{ 0 };
+};
+/// Allow first N calls only
+struct RateLimitFirstN {
+    constexpr RateLimitFirstN() noexcept {}
+    inline bool allow(uint64_t const n, uint64_t& suppressed) noexcept {
+        // Plain load once done, no write on suppressed path
+        if (this->count.load(std::memory_order_relaxed) >= n) {
+            return false;
+        }
+        suppressed = 0;
+        return this->count.fetch_add(1, std::memory_order_relaxed) < n;
+    }
+    std::atomic<uint64_t> count{ 0 };
+};
+/// Allow at most one call per @a ms
+struct RateLimitEveryT {
+    constexpr RateLimitEveryT() noexcept {}
+    inline bool allow(uint64_t const ms, uint64_t& suppressed) noexcept {
+        uint64_t const now = RateLimitNowNs();
+        uint64_t next = this->next.load(std::memory_order_relaxed);
+        if (now < next || !this->next.compare_exchange_strong(next,
+            now + ms * 1000000ull, std::memory_order_relaxed)) {
+            this->suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressed = this->suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+    /// Ns when next call allowed
+    std::atomic<uint64_t> next{ 0 };
+    std::atomic<uint64_t> suppressed{ 0 };
+};
+/**
+ * Token bucket of @a perSec tokens per second and @a burst capacity, kept
+ * as one theoretical arrival time (GCRA) so a call is one CAS
+ */
+struct RateLimitTokenBucket {
+    constexpr RateLimitTokenBucket() noexcept {}
+    inline bool allow(uint32_t const perSec, uint32_t const burst,
+        uint64_t& suppressed) noexcept {
+        uint64_t const interval = 1000000000ull / (perSec ? perSec : 1);
+        uint64_t const limit = interval * (burst ? burst : 1);
+        uint64_t const now = RateLimitNowNs();
+        uint64_t tat = this->tat.load(std::memory_order_relaxed);
+        for (;;) {
+            uint64_t const next = (tat > now ? tat : now) + interval;
+            if (next - now > limit) {
+                this->suppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (this->tat.compare_exchange_weak(tat, next,
+                std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        suppressed = this->suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+    /// Theoretical arrival time ns, bucket full when <= now
+    std::atomic<uint64_t> tat{ 0 };
+    std::atomic<uint64_t> suppressed{ 0 };
+};
+}//namespace log
+}//namespace cti
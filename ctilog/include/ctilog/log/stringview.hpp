@@ -0,0 +1,80 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file ctilog/log/stringview.hpp
+ * Non-owning string for the Logger API, C++11 has no std::string_view
+ *
+ * Made implicitly from a literal, char const* or std::string, so names and
+ * msgs reach the sink without a std::string. Converts implicitly to
+ * std::string, so AppendCallbacks taking std::string const& still work.
+ */
+#pragma once
+#include <string.h>
+#include <algorithm>
+#include <ostream>
+#include <string>
+namespace cti {
+namespace log
+{
+/**
+ * @struct StringView
+ * Pointer and length, not owning and not '\0' ended
+ * @note nullptr data means absent (e.g. no name), "" is present but empty
+ */
+struct StringView {
+    constexpr StringView() noexcept {}
+    inline StringView(char const* const s) noexcept:
+        ptr(s), len(s ? ::strlen(s) : 0) {}
+    constexpr StringView(char const* const s, size_t const n) noexcept:
+        ptr(s), len(n) {}
+    inline StringView(std::string const& s) noexcept:
+        ptr(s.data()), len(s.length()) {}
+    constexpr char const* data() const noexcept { return this->ptr; }
+    constexpr size_t size() const noexcept { return this->len; }
+    constexpr size_t length() const noexcept { return this->len; }
+    constexpr bool empty() const noexcept { return !this->len; }
+    constexpr char const* begin() const noexcept { return this->ptr; }
+    constexpr char const* end() const noexcept { return this->ptr + this->len; }
+    inline operator std::string() const {
+        return this->ptr ? std::string(this->ptr, this->len) : std::string();
+    }
+    inline int compare(StringView const& other) const noexcept {
+        size_t const n = std::min(this->len, other.len);
+        int const c = n ? ::memcmp(this->ptr, other.ptr, n) : 0;
+        if (c) {
+            return c;
+        }
+        return this->len < other.len ? -1 : (this->len > other.len ? 1 : 0);
+    }
+private:
+    char const* ptr{ nullptr };
+    size_t len{ 0 };
+};
+inline bool operator==(StringView const& a, StringView const& b) noexcept
+{
+    return a.size() == b.size() && !a.compare(b);
+}
+inline bool operator!=(StringView const& a, StringView const& b) noexcept
+{
+    return !(a == b);
+}
+inline bool operator<(StringView const& a, StringView const& b) noexcept
+{
+    return a.compare(b) < 0;
+}
+inline std::ostream& operator<<(std::ostream& os, StringView const& s)
+{
+    return os.write(s.data(), std::streamsize(s.size()));
+}
+}//namespace log
+}//namespace cti
@@ -0,0 +1,121 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file ctilog/log/uring.hpp
+ * File writer on Linux io_uring, by raw syscalls (no liburing), see
+ * Logger::startUring
+ *
+ * Data is copied into one of a few buffers; a full one is submitted as a
+ * write at its own file offset and the next filled meanwhile. Completions
+ * are reaped from the mapped completion ring without a syscall, a syscall
+ * waits only when every buffer is in flight. Buffers submitted by one enter
+ * are linked, so they are written in file order. A short or failed write is
+ * finished by pwrite.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <memory>
+#include <string>
+namespace cti {
+namespace log
+{
+constexpr uint32_t kDefaultUringBuffers = 4;
+constexpr uint32_t kDefaultUringBufferBytes = 64 * 1024;
+/**
+ * @struct UringWriter
+ * Appends to one file at a time through io_uring
+ * @note Not thread safe, Logger calls it under writemutex
+ */
+struct UringWriter {
+    UringWriter() noexcept {}
+    ~UringWriter() noexcept;
+    UringWriter(UringWriter const&) = delete;
+    UringWriter& operator=(UringWriter const&) = delete;
+    /**
+     * Set up io_uring and @a buffers (2 to 64) of @a bufferBytes
+     * @return 0 when success, -ENOSYS or -EPERM when kernel has no io_uring
+     * or it is disabled, else -errno
+     */
+    int open(uint32_t const buffers, uint32_t const bufferBytes) noexcept;
+    /// Detach and tear down
+    void close() noexcept;
+    /**
+     * Write @a path from its end, by an fd of its own
+     * @return 0 when success else -errno
+     */
+    int attach(std::string const& path) noexcept;
+    /// Drain and close file
+    void detach() noexcept;
+    inline bool isAttached() const noexcept { return this->fd >= 0; }
+    /// Copy @a len bytes, submit buffers filled, @return 0 or -errno
+    int write(char const* data, size_t len) noexcept;
+    /// Submit buffer being filled, reap done, no wait
+    int submit() noexcept;
+    /// Submit and wait all written, @return 0 or first -errno
+    int drain() noexcept;
+    /**
+     * pwrite buffer being filled and ones in flight at their offsets,
+     * written twice harmlessly when kernel finishes them too
+     * @note Async-signal-safe
+     */
+    void crashFlush() noexcept;
+private:
+    enum class State: uint8_t { Free, Filling, InFlight };
+    struct Buffer {
+        std::unique_ptr<char[]> data;
+        struct iovec iov;
+        uint32_t len{ 0 };
+        uint64_t offset{ 0 };
+        State state{ State::Free };
+    };
+    /// Queue buffer @a i, linked to one queued before in this enter
+    void queue(uint32_t const i) noexcept;
+    /// io_uring_enter queued, wait @a minComplete, then reap
+    int enter(uint32_t const minComplete) noexcept;
+    void reap() noexcept;
+    /// Next free buffer to fill, waits when none, @return -errno on error
+    int nextBuffer() noexcept;
+    int ringFd{ -1 };
+    int fd{ -1 };
+    /// Offset of next byte written
+    uint64_t offset{ 0 };
+    std::unique_ptr<Buffer[]> buffers;
+    uint32_t count{ 0 };
+    uint32_t bufferBytes{ 0 };
+    /// Buffer being filled, count when none
+    uint32_t filling{ 0 };
+    uint32_t inFlight{ 0 };
+    /// Queued in submission ring, not entered yet
+    uint32_t queued{ 0 };
+    /// First error of a write not recovered by pwrite, reported once
+    int error{ 0 };
+    // Mapped rings
+    void* sqMap{ nullptr };
+    size_t sqMapSize{ 0 };
+    void* cqMap{ nullptr };
+    size_t cqMapSize{ 0 };
+    void* sqes{ nullptr };
+    size_t sqesSize{ 0 };
+    uint32_t* sqHead{ nullptr };
+    uint32_t* sqTail{ nullptr };
+    uint32_t sqMask{ 0 };
+    uint32_t* sqArray{ nullptr };
+    uint32_t* cqHead{ nullptr };
+    uint32_t* cqTail{ nullptr };
+    uint32_t cqMask{ 0 };
+    void* cqes{ nullptr };
+};
+}//namespace log
+}//namespace cti
@@ -17,11 +17,109 @@
  * - 1 include ctilog/log.hpp
  * - 2 include this file
  * - 3 define a const char* constexpr or string named kN
+ *
+ * Log macros cache the default Logger per callsite and thread in a
+ * LoggerHandle, so they skip the registry unless it or a level changed.
+ * Their msg is streamed into the thread's reused ScopedLogStream, see
+ * ctilog/log/logstream.hpp, and passed to the Logger without a copy. Name,
+ * file basename, line and level go as one static Callsite, see
+ * ctilog/log/callsite.hpp, whose " (file+line)" is rendered once.
+ *
+ * Define CTILOG_ACTIVE_LEVEL before including this file (or by compiler
+ * flag, e.g. -DCTILOG_ACTIVE_LEVEL=3) to strip levels above it at compile
+ * time: their macros become empty but msg is still type-checked. Macros
+ * taking level as an argument (LogFmt, LogBin, LogEveryN etc.) are stripped
+ * the same way, by CTILOG_SELECT.
+ *
+ * LogFmt(Warn, "speed {} at {}", v, x) formats args straight into a reused
+ * buffer, see ctilog/log/format.hpp. LogBin takes the same format and defers
+ * formatting: in binary mode (Logger::startBinary) only raw args are written,
+ * see ctilog/log/binary.hpp. Both fail to compile when fmt has an unpaired
+ * brace or its "{}" count is not the arg count.
+ *
+ * Rate limited macros take level as LogLevel name, e.g.
+ * LogEveryT(Warn, 1000, "stuck " << x); a line emitted after skipped ones
+ * ends with " (suppressed K)".
  */
 #pragma once
 #ifndef CTI_BASE_LOG_HPP
     #error("Please include ctilog/log.hpp before this file")
 #endif
+#include <utility>
+#include "ctilog/log/ratelimit.hpp"
+/// Numbers of LogLevel for CTILOG_ACTIVE_LEVEL
+#define CTILOG_LEVEL_FATA 0
+#define CTILOG_LEVEL_ERRO 1
+#define CTILOG_LEVEL_WARN 2
+#define CTILOG_LEVEL_NOTE 3
+#define CTILOG_LEVEL_INFO 4
+#define CTILOG_LEVEL_TRAC 5
+#define CTILOG_LEVEL_DEBU 6
+#define CTILOG_LEVEL_DETA 7
+/// @def CTILOG_ACTIVE_LEVEL max level compiled in, default all
+#ifndef CTILOG_ACTIVE_LEVEL
+#define CTILOG_ACTIVE_LEVEL CTILOG_LEVEL_DETA
+#endif
+static_assert(CTILOG_LEVEL_DETA == uint32_t(cti::log::LogLevel::Deta),
+    "CTILOG_LEVEL_* should follow LogLevel");
+/**
+ * @def CTILOG_CALLSITE static descriptor ctilogSite of this macro callsite
+ * @note Constant initialized, no guard, when kN is a constexpr char const*
+ */
+#define CTILOG_CALLSITE(lvl) \
+    static cti::log::Callsite const ctilogSite(cti::log::CallsiteName(kN), \
+        cti::log::CallsiteBasename(__FILE__), __LINE__, __func__, \
+        cti::log::LogLevel::lvl)
+/// @def CTILOG_STRIPPED stripped macro body, msg only in unevaluated sizeof
+#define CTILOG_STRIPPED(msg) { \
+    static_cast<void>(sizeof(kN)); \
+    static_cast<void>(sizeof(std::declval<std::ostream&>() << msg)); \
+}
+/**
+ * @def CTILOG_SELECT(lvl, kept, stripped) name of macro @a kept when level
+ * @a lvl (a LogLevel name) is compiled in, else @a stripped; args follow
+ */
+#define CTILOG_SELECT(lvl, kept, stripped) CTILOG_SELECT_##lvl(kept, stripped)
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_FATA
+#define CTILOG_SELECT_Fata(kept, stripped) kept
+#else
+#define CTILOG_SELECT_Fata(kept, stripped) stripped
+#endif
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_ERRO
+#define CTILOG_SELECT_Erro(kept, stripped) kept
+#else
+#define CTILOG_SELECT_Erro(kept, stripped) stripped
+#endif
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_WARN
+#define CTILOG_SELECT_Warn(kept, stripped) kept
+#else
+#define CTILOG_SELECT_Warn(kept, stripped) stripped
+#endif
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_NOTE
+#define CTILOG_SELECT_Note(kept, stripped) kept
+#else
+#define CTILOG_SELECT_Note(kept, stripped) stripped
+#endif
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_INFO
+#define CTILOG_SELECT_Info(kept, stripped) kept
+#else
+#define CTILOG_SELECT_Info(kept, stripped) stripped
+#endif
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_TRAC
+#define CTILOG_SELECT_Trac(kept, stripped) kept
+#else
+#define CTILOG_SELECT_Trac(kept, stripped) stripped
+#endif
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_DEBU
+#define CTILOG_SELECT_Debu(kept, stripped) kept
+#else
+#define CTILOG_SELECT_Debu(kept, stripped) stripped
+#endif
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_DETA
+#define CTILOG_SELECT_Deta(kept, stripped) kept
+#else
+#define CTILOG_SELECT_Deta(kept, stripped) stripped
+#endif
 /// @def Assert assert, throw a exception when fail
 #define Assert(cond, msg) if (!(cond)) { \
     std::string e = std::string(#cond " fail: "); \
@@ -39,48 +137,202 @@
     throw std::runtime_error(ss.str()); \
 }
 /// @def Fatal output fatal log
-#define Fatal(msg) if (cti::log::Logger::getLogger().isLogable(cti::log::LogLevel::Fata)) { \
-    std::stringstream ss; \
-    ss << msg << " (" << __FILE__ << "+" << __LINE__ << ")"; \
-    cti::log::Logger::getLogger().f(kN, ss.str()); \
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_FATA
+#define Fatal(msg) { \
+    static thread_local cti::log::LoggerHandle ctilogHandle; \
+    if (ctilogHandle.isLogable(cti::log::LogLevel::Fata)) { \
+        CTILOG_CALLSITE(Fata); \
+        cti::log::EpochGuard ctilogEpoch; \
+        cti::log::ScopedLogStream ctilogStream; \
+        ctilogStream.stream() << msg; \
+        ctilogHandle.get().append(ctilogSite, ctilogStream.view()); \
+    } \
 }
+#else
+#define Fatal(msg) CTILOG_STRIPPED(msg)
+#endif
 /// @def Error output error log
-#define Error(msg) if (cti::log::Logger::getLogger().isLogable(cti::log::LogLevel::Erro)) { \
-    std::stringstream ss; \
-    ss << msg << " (" << __FILE__ << "+" << __LINE__ << ")"; \
-    cti::log::Logger::getLogger().e(kN, ss.str()); \
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_ERRO
+#define Error(msg) { \
+    static thread_local cti::log::LoggerHandle ctilogHandle; \
+    if (ctilogHandle.isLogable(cti::log::LogLevel::Erro)) { \
+        CTILOG_CALLSITE(Erro); \
+        cti::log::EpochGuard ctilogEpoch; \
+        cti::log::ScopedLogStream ctilogStream; \
+        ctilogStream.stream() << msg; \
+        ctilogHandle.get().append(ctilogSite, ctilogStream.view()); \
+    } \
 }
+#else
+#define Error(msg) CTILOG_STRIPPED(msg)
+#endif
 /// @def Warning output warning log
-#define Warn(msg) if (cti::log::Logger::getLogger().isLogable(cti::log::LogLevel::Warn)) { \
-    std::stringstream ss; \
-    ss << msg << " (" << __FILE__ << "+" << __LINE__ << ")"; \
-    cti::log::Logger::getLogger().w(kN, ss.str()); \
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_WARN
+#define Warn(msg) { \
+    static thread_local cti::log::LoggerHandle ctilogHandle; \
+    if (ctilogHandle.isLogable(cti::log::LogLevel::Warn)) { \
+        CTILOG_CALLSITE(Warn); \
+        cti::log::EpochGuard ctilogEpoch; \
+        cti::log::ScopedLogStream ctilogStream; \
+        ctilogStream.stream() << msg; \
+        ctilogHandle.get().append(ctilogSite, ctilogStream.view()); \
+    } \
 }
+#else
+#define Warn(msg) CTILOG_STRIPPED(msg)
+#endif
 /// @def Note output note log
-#define Note(msg) if (cti::log::Logger::getLogger().isLogable(cti::log::LogLevel::Note)) { \
-    std::stringstream ss; \
-    ss << msg << " (" << __FILE__ << "+" << __LINE__ << ")"; \
-    cti::log::Logger::getLogger().n(kN, ss.str()); \
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_NOTE
+#define Note(msg) { \
+    static thread_local cti::log::LoggerHandle ctilogHandle; \
+    if (ctilogHandle.isLogable(cti::log::LogLevel::Note)) { \
+        CTILOG_CALLSITE(Note); \
+        cti::log::EpochGuard ctilogEpoch; \
+        cti::log::ScopedLogStream ctilogStream; \
+        ctilogStream.stream() << msg; \
+        ctilogHandle.get().append(ctilogSite, ctilogStream.view()); \
+    } \
 }
+#else
+#define Note(msg) CTILOG_STRIPPED(msg)
+#endif
 /// @def Info output info log
-#define Info(msg) if (cti::log::Logger::getLogger().isLogable(cti::log::LogLevel::Info)) { \
-    std::stringstream ss; \
-    ss << msg << " (" << __FILE__ << "+" << __LINE__ << ")"; \
-    cti::log::Logger::getLogger().i(kN, ss.str());\
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_INFO
+#define Info(msg) { \
+    static thread_local cti::log::LoggerHandle ctilogHandle; \
+    if (ctilogHandle.isLogable(cti::log::LogLevel::Info)) { \
+        CTILOG_CALLSITE(Info); \
+        cti::log::EpochGuard ctilogEpoch; \
+        cti::log::ScopedLogStream ctilogStream; \
+        ctilogStream.stream() << msg; \
+        ctilogHandle.get().append(ctilogSite, ctilogStream.view()); \
+    } \
 }
+#else
+#define Info(msg) CTILOG_STRIPPED(msg)
+#endif
 /// @def Trace output trace log
-#define Trace() cti::log::Logger::getLogger().append(\
-    kN, __FILE__, __LINE__, __func__, cti::log::LogLevel::Trac)
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_TRAC
+#define Trace() { \
+    static thread_local cti::log::LoggerHandle ctilogHandle; \
+    if (ctilogHandle.isLogable(cti::log::LogLevel::Trac)) { \
+        CTILOG_CALLSITE(Trac); \
+        cti::log::EpochGuard ctilogEpoch; \
+        ctilogHandle.get().append(ctilogSite, ctilogSite.func); \
+    } \
+}
+#else
+#define Trace() { static_cast<void>(sizeof(kN)); }
+#endif
 /// @def Debug output debug log
-#define Debug(msg) if (cti::log::Logger::getLogger().isLogable(cti::log::LogLevel::Debu)) { \
-    std::stringstream ss; \
-    ss << msg << " (" << __FILE__ << "+" << __LINE__ << ")"; \
-    cti::log::Logger::getLogger().d(kN, ss.str()); \
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_DEBU
+#define Debug(msg) { \
+    static thread_local cti::log::LoggerHandle ctilogHandle; \
+    if (ctilogHandle.isLogable(cti::log::LogLevel::Debu)) { \
+        CTILOG_CALLSITE(Debu); \
+        cti::log::EpochGuard ctilogEpoch; \
+        cti::log::ScopedLogStream ctilogStream; \
+        ctilogStream.stream() << msg; \
+        ctilogHandle.get().append(ctilogSite, ctilogStream.view()); \
+    } \
 }
+#else
+#define Debug(msg) CTILOG_STRIPPED(msg)
+#endif
 /// @def Detail output debug log
-#define Detail(msg) if (cti::log::Logger::getLogger().isLogable(cti::log::LogLevel::Deta)) { \
-    std::stringstream ss; \
-    ss << msg; \
-    cti::log::Logger::getLogger().append(kN, __FILE__, __LINE__, ss.str(), cti::log::LogLevel::Deta); \
+#if CTILOG_ACTIVE_LEVEL >= CTILOG_LEVEL_DETA
+#define Detail(msg) { \
+    static thread_local cti::log::LoggerHandle ctilogHandle; \
+    if (ctilogHandle.isLogable(cti::log::LogLevel::Deta)) { \
+        CTILOG_CALLSITE(Deta); \
+        cti::log::EpochGuard ctilogEpoch; \
+        cti::log::ScopedLogStream ctilogStream; \
+        ctilogStream.stream() << msg; \
+        ctilogHandle.get().append(ctilogSite, ctilogStream.view()); \
+    } \
+}
+#else
+#define Detail(msg) CTILOG_STRIPPED(msg)
+#endif
+/**
+ * @def CTILOG_LIMITED log when callsite limiter allows
+ * @param allowCall call on limiter ctilogLimit, sets ctilogSuppressed
+ */
+#define CTILOG_LIMITED(lvl, type, allowCall, msg) CTILOG_SELECT(lvl, \
+    CTILOG_LIMITED_KEPT, CTILOG_LIMITED_STRIPPED)(lvl, type, allowCall, msg)
+#define CTILOG_LIMITED_STRIPPED(lvl, type, allowCall, msg) CTILOG_STRIPPED(msg)
+#define CTILOG_LIMITED_KEPT(lvl, type, allowCall, msg) { \
+    static thread_local cti::log::LoggerHandle ctilogHandle; \
+    if (ctilogHandle.isLogable(cti::log::LogLevel::lvl)) { \
+        static type ctilogLimit; \
+        uint64_t ctilogSuppressed = 0; \
+        if (ctilogLimit.allowCall) { \
+            CTILOG_CALLSITE(lvl); \
+            cti::log::EpochGuard ctilogEpoch; \
+            cti::log::ScopedLogStream ctilogStream; \
+            ctilogStream.stream() << msg; \
+            if (ctilogSuppressed) { \
+                ctilogStream.stream() << " (suppressed " << \
+                    ctilogSuppressed << ")"; \
+            } \
+            ctilogHandle.get().append(ctilogSite, ctilogStream.view()); \
+        } \
+    } \
+}
+/// @def LogEveryN log 1st, n+1th, 2n+1th ... time
+#define LogEveryN(lvl, n, msg) CTILOG_LIMITED(lvl, \
+    cti::log::RateLimitEveryN, allow((n), ctilogSuppressed), msg)
+/// @def LogFirstN log first n times only
+#define LogFirstN(lvl, n, msg) CTILOG_LIMITED(lvl, \
+    cti::log::RateLimitFirstN, allow((n), ctilogSuppressed), msg)
+/// @def LogEveryT log at most once per ms milliseconds
+#define LogEveryT(lvl, ms, msg) CTILOG_LIMITED(lvl, \
+    cti::log::RateLimitEveryT, allow((ms), ctilogSuppressed), msg)
+/// @def LogRate log at most perSec per second on average, burst at once
+#define LogRate(lvl, perSec, burst, msg) CTILOG_LIMITED(lvl, \
+    cti::log::RateLimitTokenBucket, \
+    allow((perSec), (burst), ctilogSuppressed), msg)
+/// @def CTILOG_FMT_CHECK compile time check of literal fmt against args
+#define CTILOG_FMT_CHECK(fmt, ...) \
+    static_assert(cti::log::FormatArgCount(fmt) >= 0, \
+        "ctilog: unpaired brace in format, use {{ or }}"); \
+    static_assert(cti::log::FormatArgCount(fmt) == int(sizeof( \
+        cti::log::FormatArgCounter(__VA_ARGS__)) - 1), \
+        "ctilog: format {} count not equal to arg count")
+/// @def CTILOG_FMT_STRIPPED stripped LogFmt/LogBin, fmt and args checked
+#define CTILOG_FMT_STRIPPED(lvl, fmt, ...) { \
+    CTILOG_FMT_CHECK(fmt, ##__VA_ARGS__); \
+    static_cast<void>(sizeof(kN)); \
+}
+/**
+ * @def LogFmt log with "{}" format, no std::stringstream for common types
+ * @param fmt string literal, "{}" for each arg
+ */
+#define LogFmt(lvl, fmt, ...) CTILOG_SELECT(lvl, \
+    CTILOG_FMT_KEPT, CTILOG_FMT_STRIPPED)(lvl, fmt, ##__VA_ARGS__)
+#define CTILOG_FMT_KEPT(lvl, fmt, ...) { \
+    CTILOG_FMT_CHECK(fmt, ##__VA_ARGS__); \
+    static thread_local cti::log::LoggerHandle ctilogHandle; \
+    if (ctilogHandle.isLogable(cti::log::LogLevel::lvl)) { \
+        CTILOG_CALLSITE(lvl); \
+        cti::log::EpochGuard ctilogEpoch; \
+        ctilogHandle.get().format(ctilogSite, fmt, ##__VA_ARGS__); \
+    } \
+}
+/**
+ * @def LogBin log with formatting deferred to ctilog-decode
+ * @param fmt string literal, "{}" for each arg
+ */
+#define LogBin(lvl, fmt, ...) CTILOG_SELECT(lvl, \
+    CTILOG_BIN_KEPT, CTILOG_FMT_STRIPPED)(lvl, fmt, ##__VA_ARGS__)
+#define CTILOG_BIN_KEPT(lvl, fmt, ...) { \
+    CTILOG_FMT_CHECK(fmt, ##__VA_ARGS__); \
+    static thread_local cti::log::LoggerHandle ctilogHandle; \
+    if (ctilogHandle.isLogable(cti::log::LogLevel::lvl)) { \
+        static cti::log::BinaryFormat const ctilogFormat( \
+            cti::log::CallsiteName(kN), cti::log::CallsiteBasename(__FILE__), \
+            __LINE__, cti::log::LogLevel::lvl, fmt); \
+        cti::log::EpochGuard ctilogEpoch; \
+        ctilogHandle.get().appendBinary(ctilogFormat, ##__VA_ARGS__); \
+    } \
 }
-
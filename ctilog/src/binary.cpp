@@ -0,0 +1,306 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+#include "ctilog/log/binary.hpp"
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#include <istream>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include "ctilog/log.hpp"
+namespace cti {
+namespace log
+{
+static std::atomic<uint32_t> kNextBinaryFormatId(1);
+uint32_t BinaryFormat::registerId() const noexcept
+{
+    uint32_t const next = kNextBinaryFormatId.fetch_add(1,
+        std::memory_order_relaxed);
+    uint32_t expected = 0;
+    // Lost race wastes next, winner's id used by all
+    if (this->id.compare_exchange_strong(expected, next,
+        std::memory_order_acq_rel, std::memory_order_acquire)) {
+        return next;
+    }
+    return expected;
+}
+template<typename T>
+static inline bool TakeArg(char const*& p, char const* const end, T& v) noexcept
+{
+    if (size_t(end - p) < sizeof(T)) {
+        return false;
+    }
+    ::memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+/// One char to @a out, a std::string or FormatBuffer
+template<typename Out>
+static inline void RenderChar(Out& out, char const c) noexcept
+{
+    out.append(&c, 1);
+}
+/// Render one arg of @a type, false when args cut
+template<typename Out>
+static bool RenderArg(char const type, char const*& p, char const* const end,
+    Out& out) noexcept
+{
+    char buf[32];
+    switch (type) {
+    case 'b': {
+        uint8_t v;
+        if (!TakeArg(p, end, v)) {
+            return false;
+        }
+        RenderChar(out, v ? '1' : '0');
+        return true;
+    }
+    case 'c': {
+        char v;
+        if (!TakeArg(p, end, v)) {
+            return false;
+        }
+        RenderChar(out, v);
+        return true;
+    }
+    case 'i': {
+        int32_t v;
+        if (!TakeArg(p, end, v)) {
+            return false;
+        }
+        out.append(buf, FormatI64(buf, int64_t(v)));
+        return true;
+    }
+    case 'I': {
+        uint32_t v;
+        if (!TakeArg(p, end, v)) {
+            return false;
+        }
+        out.append(buf, FormatU64(buf, uint64_t(v)));
+        return true;
+    }
+    case 'l': {
+        int64_t v;
+        if (!TakeArg(p, end, v)) {
+            return false;
+        }
+        out.append(buf, FormatI64(buf, v));
+        return true;
+    }
+    case 'L': {
+        uint64_t v;
+        if (!TakeArg(p, end, v)) {
+            return false;
+        }
+        out.append(buf, FormatU64(buf, v));
+        return true;
+    }
+    case 'p': {
+        uint64_t v;
+        if (!TakeArg(p, end, v)) {
+            return false;
+        }
+        int const n = ::snprintf(buf, sizeof(buf), "0x%llx",
+            static_cast<unsigned long long>(v));
+        out.append(buf, size_t(n));
+        return true;
+    }
+    case 'f': {
+        float v;
+        if (!TakeArg(p, end, v)) {
+            return false;
+        }
+        out.append(buf, FormatFloat(buf, v));
+        return true;
+    }
+    case 'd': {
+        double v;
+        if (!TakeArg(p, end, v)) {
+            return false;
+        }
+        out.append(buf, FormatDouble(buf, v));
+        return true;
+    }
+    case 's': {
+        uint32_t len;
+        if (!TakeArg(p, end, len) || size_t(end - p) < len) {
+            return false;
+        }
+        out.append(p, len);
+        p += len;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+template<typename Out>
+static bool RenderArgs(char const* const fmt, char const* const types,
+    char const* const args, size_t const argsLen, Out& out) noexcept
+{
+    char const* p = args;
+    char const* const end = args + argsLen;
+    char const* t = types;
+    for (char const* f = fmt; *f; ++f) {
+        if ('{' == f[0] && '{' == f[1]) {
+            RenderChar(out, '{');
+            ++f;
+        } else if ('}' == f[0] && '}' == f[1]) {
+            RenderChar(out, '}');
+            ++f;
+        } else if ('{' == f[0] && '}' == f[1] && *t) {
+            if (!RenderArg(*t++, p, end, out)) {
+                return false;
+            }
+            ++f;
+        } else {
+            RenderChar(out, *f);
+        }
+    }
+    // Args without placeholder
+    while (*t) {
+        RenderChar(out, ' ');
+        if (!RenderArg(*t++, p, end, out)) {
+            return false;
+        }
+    }
+    return true;
+}
+bool RenderBinaryArgs(char const* const fmt, char const* const types,
+    char const* const args, size_t const argsLen, std::string& out) noexcept
+{
+    return RenderArgs(fmt, types, args, argsLen, out);
+}
+bool RenderBinaryArgs(char const* const fmt, char const* const types,
+    char const* const args, size_t const argsLen, FormatBuffer& out) noexcept
+{
+    return RenderArgs(fmt, types, args, argsLen, out);
+}
+/// Format entry read back from file
+struct BinaryFormatEntry {
+    LogLevel level;
+    int32_t line;
+    std::string name;
+    std::string file;
+    std::string fmt;
+    std::string types;
+};
+template<typename T>
+static inline bool ReadValue(std::istream& in, T& v) noexcept
+{
+    return bool(in.read(reinterpret_cast<char*>(&v), sizeof(T)));
+}
+static inline bool ReadString16(std::istream& in, std::string& s) noexcept
+{
+    uint16_t len;
+    if (!ReadValue(in, len)) {
+        return false;
+    }
+    s.resize(len);
+    return !len || bool(in.read(&s[0], len));
+}
+int64_t DecodeBinaryLog(std::istream& in, std::ostream& out,
+    bool const hasTid) noexcept
+{
+    char magic[sizeof(kBinaryMagic)];
+    if (!in.read(magic, sizeof(magic)) ||
+        ::memcmp(magic, kBinaryMagic, sizeof(magic))) {
+        return -EBADMSG;
+    }
+    std::unordered_map<uint32_t, BinaryFormatEntry> formats;
+    std::vector<char> args;
+    std::string line;
+    int64_t records = 0;
+    char tag;
+    while (in.get(tag)) {
+        if (kBinaryFormatTag == tag) {
+            uint32_t id;
+            uint8_t level;
+            BinaryFormatEntry e;
+            if (!ReadValue(in, id) || !ReadValue(in, level) ||
+                !ReadValue(in, e.line) || !ReadString16(in, e.name) ||
+                !ReadString16(in, e.file) || !ReadString16(in, e.fmt) ||
+                !ReadString16(in, e.types)) {
+                return -EBADMSG;
+            }
+            e.level = static_cast<LogLevel>(level);
+            formats[id] = std::move(e);
+            continue;
+        }
+        if (kBinaryRecordTag != tag) {
+            return -EBADMSG;
+        }
+        uint32_t id;
+        uint64_t idx;
+        uint64_t tid;
+        timespec time;
+        int64_t sec;
+        uint32_t nsec;
+        uint32_t argsLen;
+        if (!ReadValue(in, id) || !ReadValue(in, idx) || !ReadValue(in, tid) ||
+            !ReadValue(in, sec) || !ReadValue(in, nsec) ||
+            !ReadValue(in, argsLen)) {
+            return -EBADMSG;
+        }
+        args.resize(argsLen);
+        if (argsLen && !in.read(args.data(), argsLen)) {
+            return -EBADMSG;
+        }
+        auto const it = formats.find(id);
+        if (formats.end() == it) {
+            return -EBADMSG;
+        }
+        BinaryFormatEntry const& e = it->second;
+        time.tv_sec = time_t(sec);
+        time.tv_nsec = long(nsec);
+        char timeBuf[kLogRealTimeMaxLen];
+        // Same layout as Logger::write
+        char num[kFormatIntMaxLen];
+        line.assign(num, FormatU64(num, idx));
+        line += '[';
+        line.append(timeBuf, FormatLogRealTime(time, timeBuf));
+        line += ' ';
+        if (hasTid) {
+            line.append(num, FormatU64(num, tid));
+            line += ' ';
+        }
+        line += logLevelToString(e.level);
+        line += ']';
+        if (!e.name.empty()) {
+            line += '[';
+            line += e.name;
+            line += ']';
+        }
+        line += ' ';
+        if (!RenderBinaryArgs(e.fmt.c_str(), e.types.c_str(), args.data(),
+            args.size(), line)) {
+            return -EBADMSG;
+        }
+        if (!e.file.empty()) {
+            line += " (";
+            line += e.file;
+            if (e.line >= 0) {
+                line += '+';
+                line.append(num, FormatI64(num, e.line));
+            }
+            line += ')';
+        }
+        line += '\n';
+        out << line;
+        ++records;
+    }
+    return records;
+}
+}//namespace log
+}//namespace cti
@@ -0,0 +1,67 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+#include "ctilog/log/callsite.hpp"
+#include <string.h>
+#include <new>
+#include "ctilog/log/format.hpp"
+namespace cti {
+namespace log
+{
+/// Head of registry, pushed by CAS and never popped
+static std::atomic<Callsite const*> kCallsites(nullptr);
+Callsite::Text const* Callsite::render() const noexcept
+{
+    size_t const fileLen = this->file ? ::strlen(this->file) : 0;
+    // " (" file "+" line ")"
+    size_t const cap = 2 + fileLen + 1 + kFormatIntMaxLen + 1;
+    char* const mem = new (std::nothrow) char[offsetof(Text, suffix) + cap];
+    if (!mem) {
+        return nullptr;
+    }
+    Text* const t = reinterpret_cast<Text*>(mem);
+    t->nameLen = uint32_t(this->name ? ::strlen(this->name) : 0);
+    char* p = t->suffix;
+    *p++ = ' ';
+    *p++ = '(';
+    if (fileLen) {
+        ::memcpy(p, this->file, fileLen);
+        p += fileLen;
+    }
+    *p++ = '+';
+    p += FormatI64(p, this->line);
+    *p++ = ')';
+    t->suffixLen = uint32_t(p - t->suffix);
+    Text const* expected = nullptr;
+    if (!this->text.compare_exchange_strong(expected, t,
+        std::memory_order_acq_rel, std::memory_order_acquire)) {
+        // Another thread rendered it first
+        delete[] mem;
+        return expected;
+    }
+    // Only the winner links this callsite
+    this->next = kCallsites.load(std::memory_order_relaxed);
+    while (!kCallsites.compare_exchange_weak(this->next, this,
+        std::memory_order_release, std::memory_order_relaxed)) {}
+    return t;
+}
+std::vector<Callsite const*> GetSeenCallsites() noexcept
+{
+    std::vector<Callsite const*> callsites;
+    for (Callsite const* c = kCallsites.load(std::memory_order_acquire); c;
+        c = c->next) {
+        callsites.push_back(c);
+    }
+    return callsites;
+}
+}//namespace log
+}//namespace cti
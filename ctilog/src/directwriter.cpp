@@ -0,0 +1,183 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+#include "ctilog/log/directwriter.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "ctilog/log/file.hpp"
+namespace cti {
+namespace log
+{
+static inline uint64_t AlignUp(uint64_t const n) noexcept
+{
+    return (n + kDirectAlign - 1) & ~uint64_t(kDirectAlign - 1);
+}
+DirectWriter::~DirectWriter() noexcept
+{
+    this->close();
+}
+int DirectWriter::open(uint32_t const bufferBytes) noexcept
+{
+    this->close();
+    uint32_t const bytes = uint32_t(AlignUp(std::min(std::max(bufferBytes,
+        kMinDirectBufferBytes), kMaxDirectBufferBytes)));
+    void* p = nullptr;
+    if (::posix_memalign(&p, kDirectAlign, bytes)) {
+        return -ENOMEM;
+    }
+    this->buffer = static_cast<char*>(p);
+    this->bufferBytes = bytes;
+    return 0;
+}
+void DirectWriter::close() noexcept
+{
+    this->detach();
+    ::free(this->buffer);
+    this->buffer = nullptr;
+    this->bufferBytes = 0;
+}
+int DirectWriter::attach(std::string const& path) noexcept
+{
+    this->detach();
+    if (!this->buffer) {
+        return -EBADF;
+    }
+    // Read too, for the last block; not O_APPEND, last block written again
+    int const fd = ::open(path.c_str(), int(PosixFileAccessMode::ReadWrite) |
+        int(PosixFileOpenFlag::Direct) | int(PosixFileOpenFlag::CloExec));
+    if (fd < 0) {
+        return -errno;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        int const ret = -errno;
+        ::close(fd);
+        return ret;
+    }
+    uint64_t const size = uint64_t(st.st_size);
+    this->base = size & ~uint64_t(kDirectAlign - 1);
+    this->len = uint32_t(size - this->base);
+    if (this->len) {
+        ssize_t const n = ::pread(fd, this->buffer, kDirectAlign,
+            off_t(this->base));
+        if (n < ssize_t(this->len)) {
+            int const ret = n < 0 ? -errno : -EIO;
+            ::close(fd);
+            this->len = 0;
+            return ret;
+        }
+    }
+    this->fd = fd;
+    this->dirty = false;
+    return 0;
+}
+void DirectWriter::detach() noexcept
+{
+    if (this->fd < 0) {
+        return;
+    }
+    this->flush();
+    ::close(this->fd);
+    this->fd = -1;
+    this->base = 0;
+    this->len = 0;
+    this->dirty = false;
+}
+int DirectWriter::writeBlocks(size_t const bytes) noexcept
+{
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t const n = ::pwrite(this->fd, this->buffer + done, bytes - done,
+            off_t(this->base + done));
+        if (n < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return -errno;
+        }
+        if (!n) {
+            return -EIO;
+        }
+        done += size_t(n);
+    }
+    return 0;
+}
+int DirectWriter::write(char const* data, size_t len) noexcept
+{
+    if (this->fd < 0) {
+        return -EBADF;
+    }
+    while (len) {
+        size_t const n = std::min(len, size_t(this->bufferBytes - this->len));
+        ::memcpy(this->buffer + this->len, data, n);
+        this->len += uint32_t(n);
+        this->dirty = true;
+        data += n;
+        len -= n;
+        if (this->len == this->bufferBytes) {
+            int const ret = this->writeBlocks(this->bufferBytes);
+            if (ret < 0) {
+                return ret;
+            }
+            this->base += this->bufferBytes;
+            this->len = 0;
+            this->dirty = false;
+        }
+    }
+    return 0;
+}
+int DirectWriter::flush() noexcept
+{
+    if (this->fd < 0 || !this->dirty) {
+        return 0;
+    }
+    size_t const padded = size_t(AlignUp(this->len));
+    ::memset(this->buffer + this->len, 0, padded - this->len);
+    int const ret = this->writeBlocks(padded);
+    if (ret < 0) {
+        return ret;
+    }
+    // Padding off the file
+    if (::ftruncate(this->fd, off_t(this->base + this->len)) < 0) {
+        return -errno;
+    }
+    // Keep the last partial block only
+    uint32_t const keep = this->len % kDirectAlign;
+    uint32_t const done = this->len - keep;
+    ::memmove(this->buffer, this->buffer + done, keep);
+    this->base += done;
+    this->len = keep;
+    this->dirty = false;
+    return 0;
+}
+void DirectWriter::crashFlush() noexcept
+{
+    // Once, the other thread may go on copying or reset it
+    uint32_t const len = this->len;
+    if (this->fd < 0 || !len) {
+        return;
+    }
+    // Unaligned end, later writes go on fine without O_DIRECT too
+    int const flags = ::fcntl(this->fd, F_GETFL);
+    if (flags < 0 || ::fcntl(this->fd, F_SETFL,
+        flags & ~int(PosixFileOpenFlag::Direct)) < 0) {
+        return;
+    }
+    this->writeBlocks(len);
+}
+}//namespace log
+}//namespace cti
@@ -0,0 +1,149 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+#include "ctilog/log/epoch.hpp"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "ctilog/log/boundedqueue.hpp"
+namespace cti {
+namespace log
+{
+/// One per thread, never freed, reused after thread exit
+struct EpochSlot {
+    /// Epoch when pinned, 0 when not pinned
+    std::atomic<uint64_t> epoch{ 0 };
+    std::atomic<bool> used{ true };
+    EpochSlot* next{ nullptr };
+    char pad[kCacheLineSize];
+};
+static std::atomic<uint64_t> kGlobalEpoch(1);
+static std::atomic<EpochSlot*> kEpochSlots(nullptr);
+/// Thread owner of a slot, give back slot when thread exit
+struct EpochSlotOwner {
+    ~EpochSlotOwner() {
+        if (this->slot) {
+            this->slot->epoch.store(0, std::memory_order_release);
+            this->slot->used.store(false, std::memory_order_release);
+        }
+    }
+    inline EpochSlot* get() noexcept {
+        if (!this->slot) {
+            this->slot = EpochSlotOwner::acquire();
+        }
+        return this->slot;
+    }
+    static EpochSlot* acquire() noexcept {
+        for (EpochSlot* s = kEpochSlots.load(std::memory_order_acquire); s;
+            s = s->next) {
+            bool expected = false;
+            if (!s->used.load(std::memory_order_relaxed) &&
+                s->used.compare_exchange_strong(expected, true)) {
+                return s;
+            }
+        }
+        EpochSlot* const s = new EpochSlot;
+        EpochSlot* head = kEpochSlots.load(std::memory_order_relaxed);
+        do {
+            s->next = head;
+        } while (!kEpochSlots.compare_exchange_weak(head, s,
+            std::memory_order_release, std::memory_order_relaxed));
+        return s;
+    }
+    EpochSlot* slot{ nullptr };
+    uint32_t depth{ 0 };
+};
+static thread_local EpochSlotOwner kEpochSlotOwner;
+struct Retired {
+    uint64_t epoch;
+    std::function<void()> deleter;
+};
+/// Retired list, run what left when process exit
+struct RetiredList {
+    ~RetiredList() {
+        for (auto& r: this->list) {
+            r.deleter();
+        }
+    }
+    std::mutex mutex;
+    std::vector<Retired> list;
+};
+static RetiredList& GetRetiredList() noexcept
+{
+    static RetiredList retired;
+    return retired;
+}
+void EpochPin() noexcept
+{
+    auto& owner = kEpochSlotOwner;
+    if (0 == owner.depth++) {
+        // Acquire: seeing an epoch bumped by EpochRetire, also see what
+        // published before it
+        owner.get()->epoch.store(kGlobalEpoch.load(std::memory_order_acquire),
+            std::memory_order_relaxed);
+        // Pin visible before any read of shared data
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+void EpochUnpin() noexcept
+{
+    auto& owner = kEpochSlotOwner;
+    if (0 == --owner.depth) {
+        owner.slot->epoch.store(0, std::memory_order_release);
+    }
+}
+void EpochRetire(std::function<void()> const& deleter) noexcept
+{
+    {
+        auto& retired = GetRetiredList();
+        std::unique_lock<std::mutex> lock(retired.mutex);
+        // Readers pinned at <= epoch may still see it
+        uint64_t const epoch = kGlobalEpoch.fetch_add(1);
+        retired.list.push_back(Retired{ epoch, deleter });
+    }
+    EpochReclaim();
+}
+void EpochReclaim() noexcept
+{
+    std::vector<Retired> ready;
+    {
+        auto& retired = GetRetiredList();
+        std::unique_lock<std::mutex> lock(retired.mutex);
+        if (retired.list.empty()) {
+            return;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t minPinned = UINT64_MAX;
+        for (EpochSlot* s = kEpochSlots.load(std::memory_order_acquire); s;
+            s = s->next) {
+            uint64_t const e = s->epoch.load(std::memory_order_acquire);
+            if (e && e < minPinned) {
+                minPinned = e;
+            }
+        }
+        auto it = retired.list.begin();
+        while (it != retired.list.end()) {
+            if (it->epoch < minPinned) {
+                ready.push_back(std::move(*it));
+                it = retired.list.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    // Deleters run without lock, they may retire again
+    for (auto& r: ready) {
+        r.deleter();
+    }
+}
+}//namespace log
+}//namespace cti
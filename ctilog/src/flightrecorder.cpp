@@ -0,0 +1,115 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+#include "ctilog/log/flightrecorder.hpp"
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <new>
+namespace cti {
+namespace log
+{
+static_assert(sizeof(FlightEntry) == kFlightSlotSize - 8,
+    "FlightEntry and seq should fill a slot");
+FlightRecorder::FlightRecorder(size_t const bytes) noexcept
+{
+    size_t n = 16;
+    while (n * 2 * kFlightSlotSize <= bytes) {
+        n *= 2;
+    }
+    // Value initialized, all seq 0 and tickets empty
+    this->slots.reset(new (std::nothrow) Slot[n]());
+    if (this->slots) {
+        this->mask = n - 1;
+    }
+}
+void FlightRecorder::capture(LogLevel const& level, StringView const& name,
+    StringView const& msg, StringView const& suffix) noexcept
+{
+    uint64_t const ticket = this->head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = this->slots[ticket & this->mask];
+    uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+    if ((seq & 1) || !slot.seq.compare_exchange_strong(seq, seq + 1,
+        std::memory_order_acquire, std::memory_order_relaxed)) {
+        this->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    FlightEntry& e = slot.entry;
+    // A writer lapped by the ring does not overwrite newer
+    if (e.ticket > ticket) {
+        slot.seq.store(seq, std::memory_order_release);
+        this->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    timespec time;
+    if (::clock_gettime(CLOCK_REALTIME_COARSE, &time)) {
+        time = timespec{ 0, 0 };
+    }
+    e.ticket = ticket + 1;
+    e.sec = time.tv_sec;
+    e.nsec = uint32_t(time.tv_nsec);
+    e.level = uint8_t(level);
+    e.tid = uint64_t(::pthread_self());
+    // Lengths clamped first, so three plain copies, name may be absent
+    size_t const room = sizeof(e.text);
+    size_t const nameLen = std::min<size_t>(name.size(), UINT8_MAX);
+    size_t const msgLen = std::min(msg.size(), room - nameLen);
+    size_t const suffixLen = std::min(suffix.size(), room - nameLen - msgLen);
+    if (nameLen) {
+        ::memcpy(e.text, name.data(), nameLen);
+    }
+    if (msgLen) {
+        ::memcpy(e.text + nameLen, msg.data(), msgLen);
+    }
+    if (suffixLen) {
+        ::memcpy(e.text + nameLen + msgLen, suffix.data(), suffixLen);
+    }
+    e.nameLen = uint8_t(nameLen);
+    e.textLen = uint16_t(nameLen + msgLen + suffixLen);
+    slot.seq.store(seq + 2, std::memory_order_release);
+}
+size_t FlightRecorder::drain(
+    std::function<void(FlightEntry const&)> const& f) noexcept
+{
+    uint64_t const end = this->head.load(std::memory_order_acquire);
+    uint64_t const oldest = end > this->mask + 1 ? end - this->mask - 1 : 0;
+    uint64_t ticket = this->drained > oldest ? this->drained : oldest;
+    this->drained = end;
+    size_t n = 0;
+    FlightEntry copy;
+    for (; ticket < end; ++ticket) {
+        Slot& slot = this->slots[ticket & this->mask];
+        uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+        // Being written, or not yet, skipped
+        if ((seq & 1) || !slot.seq.compare_exchange_strong(seq, seq + 1,
+            std::memory_order_acquire, std::memory_order_relaxed)) {
+            continue;
+        }
+        bool const hit = slot.entry.ticket == ticket + 1;
+        if (hit) {
+            ::memcpy(&copy, &slot.entry, offsetof(FlightEntry, text) +
+                slot.entry.textLen);
+        }
+        // Give back unchanged, writers bump by 2
+        slot.seq.store(seq, std::memory_order_release);
+        if (hit) {
+            try {
+                f(copy);
+            } catch (...) {}
+            ++n;
+        }
+    }
+    return n;
+}
+}//namespace log
+}//namespace cti
@@ -0,0 +1,470 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+#include "ctilog/log/format.hpp"
+#include <stdio.h>
+namespace cti {
+namespace log
+{
+void FormatBuffer::grow(size_t const need) noexcept
+{
+    size_t cap = this->cap ? this->cap : 256;
+    while (cap < need) {
+        cap *= 2;
+    }
+    std::unique_ptr<char[]> buf(new char[cap]);
+    if (this->len) {
+        ::memcpy(buf.get(), this->buf.get(), this->len);
+    }
+    this->buf = std::move(buf);
+    this->cap = cap;
+}
+static char const kDigitPairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+static inline size_t CountDigits(uint64_t v) noexcept
+{
+    size_t n = 1;
+    for (;;) {
+        if (v < 10) {
+            return n;
+        }
+        if (v < 100) {
+            return n + 1;
+        }
+        if (v < 1000) {
+            return n + 2;
+        }
+        if (v < 10000) {
+            return n + 3;
+        }
+        v /= 10000;
+        n += 4;
+    }
+}
+size_t FormatU64(char* const buf, uint64_t v) noexcept
+{
+    size_t const len = CountDigits(v);
+    // Two digits per division, from the end
+    char* p = buf + len;
+    while (v >= 100) {
+        size_t const i = size_t(v % 100) * 2;
+        v /= 100;
+        p -= 2;
+        ::memcpy(p, kDigitPairs + i, 2);
+    }
+    if (v >= 10) {
+        ::memcpy(p - 2, kDigitPairs + size_t(v) * 2, 2);
+    } else {
+        *--p = char('0' + v);
+    }
+    return len;
+}
+size_t FormatI64(char* const buf, int64_t const v) noexcept
+{
+    if (v < 0) {
+        *buf = '-';
+        // No overflow for INT64_MIN
+        return 1 + FormatU64(buf + 1, 0 - uint64_t(v));
+    }
+    return FormatU64(buf, uint64_t(v));
+}
+/*
+ * Grisu2 (Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+ * with Integers", PLDI 2010): shortest or near shortest digits, always read
+ * back to the same value
+ */
+namespace
+{
+/// f * 2^e
+struct DiyFp {
+    uint64_t f;
+    int e;
+};
+inline DiyFp operator-(DiyFp const& a, DiyFp const& b) noexcept
+{
+    return DiyFp{ a.f - b.f, a.e };
+}
+/**
+ * Upper 64 bits of product, rounded
+ * @note Four 32x32 products as reference Grisu2, no __int128 on 32 bit
+ * targets such as armv7
+ */
+inline DiyFp operator*(DiyFp const& a, DiyFp const& b) noexcept
+{
+    constexpr uint64_t kLow32 = 0xffffffffu;
+    uint64_t const ah = a.f >> 32;
+    uint64_t const al = a.f & kLow32;
+    uint64_t const bh = b.f >> 32;
+    uint64_t const bl = b.f & kLow32;
+    uint64_t const hh = ah * bh;
+    uint64_t const lh = al * bh;
+    uint64_t const hl = ah * bl;
+    uint64_t const ll = al * bl;
+    // Bits 32..95 of product, plus half of bit 64 to round
+    uint64_t const mid = (ll >> 32) + (hl & kLow32) + (lh & kLow32) +
+        (uint64_t(1) << 31);
+    return DiyFp{ hh + (hl >> 32) + (lh >> 32) + (mid >> 32),
+        a.e + b.e + 64 };
+}
+inline DiyFp Normalize(DiyFp const& v) noexcept
+{
+    int const s = __builtin_clzll(v.f);
+    return DiyFp{ v.f << s, v.e - s };
+}
+/// Normalized 10^k for k = -348 + 8i, generated with exact arithmetic
+DiyFp const kCachedPowers[] = {
+    { 0xfa8fd5a0081c0288ull, -1220 }, // 1e-348
+    { 0xbaaee17fa23ebf76ull, -1193 }, // 1e-340
+    { 0x8b16fb203055ac76ull, -1166 }, // 1e-332
+    { 0xcf42894a5dce35eaull, -1140 }, // 1e-324
+    { 0x9a6bb0aa55653b2dull, -1113 }, // 1e-316
+    { 0xe61acf033d1a45dfull, -1087 }, // 1e-308
+    { 0xab70fe17c79ac6caull, -1060 }, // 1e-300
+    { 0xff77b1fcbebcdc4full, -1034 }, // 1e-292
+    { 0xbe5691ef416bd60cull, -1007 }, // 1e-284
+    { 0x8dd01fad907ffc3cull, -980 }, // 1e-276
+    { 0xd3515c2831559a83ull, -954 }, // 1e-268
+    { 0x9d71ac8fada6c9b5ull, -927 }, // 1e-260
+    { 0xea9c227723ee8bcbull, -901 }, // 1e-252
+    { 0xaecc49914078536dull, -874 }, // 1e-244
+    { 0x823c12795db6ce57ull, -847 }, // 1e-236
+    { 0xc21094364dfb5637ull, -821 }, // 1e-228
+    { 0x9096ea6f3848984full, -794 }, // 1e-220
+    { 0xd77485cb25823ac7ull, -768 }, // 1e-212
+    { 0xa086cfcd97bf97f4ull, -741 }, // 1e-204
+    { 0xef340a98172aace5ull, -715 }, // 1e-196
+    { 0xb23867fb2a35b28eull, -688 }, // 1e-188
+    { 0x84c8d4dfd2c63f3bull, -661 }, // 1e-180
+    { 0xc5dd44271ad3cdbaull, -635 }, // 1e-172
+    { 0x936b9fcebb25c996ull, -608 }, // 1e-164
+    { 0xdbac6c247d62a584ull, -582 }, // 1e-156
+    { 0xa3ab66580d5fdaf6ull, -555 }, // 1e-148
+    { 0xf3e2f893dec3f126ull, -529 }, // 1e-140
+    { 0xb5b5ada8aaff80b8ull, -502 }, // 1e-132
+    { 0x87625f056c7c4a8bull, -475 }, // 1e-124
+    { 0xc9bcff6034c13053ull, -449 }, // 1e-116
+    { 0x964e858c91ba2655ull, -422 }, // 1e-108
+    { 0xdff9772470297ebdull, -396 }, // 1e-100
+    { 0xa6dfbd9fb8e5b88full, -369 }, // 1e-92
+    { 0xf8a95fcf88747d94ull, -343 }, // 1e-84
+    { 0xb94470938fa89bcfull, -316 }, // 1e-76
+    { 0x8a08f0f8bf0f156bull, -289 }, // 1e-68
+    { 0xcdb02555653131b6ull, -263 }, // 1e-60
+    { 0x993fe2c6d07b7facull, -236 }, // 1e-52
+    { 0xe45c10c42a2b3b06ull, -210 }, // 1e-44
+    { 0xaa242499697392d3ull, -183 }, // 1e-36
+    { 0xfd87b5f28300ca0eull, -157 }, // 1e-28
+    { 0xbce5086492111aebull, -130 }, // 1e-20
+    { 0x8cbccc096f5088ccull, -103 }, // 1e-12
+    { 0xd1b71758e219652cull, -77 }, // 1e-4
+    { 0x9c40000000000000ull, -50 }, // 1e4
+    { 0xe8d4a51000000000ull, -24 }, // 1e12
+    { 0xad78ebc5ac620000ull, 3 }, // 1e20
+    { 0x813f3978f8940984ull, 30 }, // 1e28
+    { 0xc097ce7bc90715b3ull, 56 }, // 1e36
+    { 0x8f7e32ce7bea5c70ull, 83 }, // 1e44
+    { 0xd5d238a4abe98068ull, 109 }, // 1e52
+    { 0x9f4f2726179a2245ull, 136 }, // 1e60
+    { 0xed63a231d4c4fb27ull, 162 }, // 1e68
+    { 0xb0de65388cc8ada8ull, 189 }, // 1e76
+    { 0x83c7088e1aab65dbull, 216 }, // 1e84
+    { 0xc45d1df942711d9aull, 242 }, // 1e92
+    { 0x924d692ca61be758ull, 269 }, // 1e100
+    { 0xda01ee641a708deaull, 295 }, // 1e108
+    { 0xa26da3999aef774aull, 322 }, // 1e116
+    { 0xf209787bb47d6b85ull, 348 }, // 1e124
+    { 0xb454e4a179dd1877ull, 375 }, // 1e132
+    { 0x865b86925b9bc5c2ull, 402 }, // 1e140
+    { 0xc83553c5c8965d3dull, 428 }, // 1e148
+    { 0x952ab45cfa97a0b3ull, 455 }, // 1e156
+    { 0xde469fbd99a05fe3ull, 481 }, // 1e164
+    { 0xa59bc234db398c25ull, 508 }, // 1e172
+    { 0xf6c69a72a3989f5cull, 534 }, // 1e180
+    { 0xb7dcbf5354e9beceull, 561 }, // 1e188
+    { 0x88fcf317f22241e2ull, 588 }, // 1e196
+    { 0xcc20ce9bd35c78a5ull, 614 }, // 1e204
+    { 0x98165af37b2153dfull, 641 }, // 1e212
+    { 0xe2a0b5dc971f303aull, 667 }, // 1e220
+    { 0xa8d9d1535ce3b396ull, 694 }, // 1e228
+    { 0xfb9b7cd9a4a7443cull, 720 }, // 1e236
+    { 0xbb764c4ca7a44410ull, 747 }, // 1e244
+    { 0x8bab8eefb6409c1aull, 774 }, // 1e252
+    { 0xd01fef10a657842cull, 800 }, // 1e260
+    { 0x9b10a4e5e9913129ull, 827 }, // 1e268
+    { 0xe7109bfba19c0c9dull, 853 }, // 1e276
+    { 0xac2820d9623bf429ull, 880 }, // 1e284
+    { 0x80444b5e7aa7cf85ull, 907 }, // 1e292
+    { 0xbf21e44003acdd2dull, 933 }, // 1e300
+    { 0x8e679c2f5e44ff8full, 960 }, // 1e308
+    { 0xd433179d9c8cb841ull, 986 }, // 1e316
+    { 0x9e19db92b4e31ba9ull, 1013 }, // 1e324
+    { 0xeb96bf6ebadf77d9ull, 1039 }, // 1e332
+    { 0xaf87023b9bf0ee6bull, 1066 }, // 1e340
+};
+constexpr int kCachedPowerMinK = -348;
+constexpr int kCachedPowerStepK = 8;
+/// 10^-K whose product with a normalized 2^e lands in [2^-60, 2^-32)
+inline DiyFp GetCachedPower(int const e, int& K) noexcept
+{
+    // log10(2) = 0.30102999566398114
+    double const dk = (-61 - e) * 0.30102999566398114 + 347;
+    int k = int(dk);
+    if (dk - k > 0.0) {
+        ++k;
+    }
+    size_t const i = size_t((k >> 3) + 1);
+    K = -(kCachedPowerMinK + int(i) * kCachedPowerStepK);
+    return kCachedPowers[i];
+}
+uint64_t const kPow10[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+    10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+    100000000000ull, 1000000000000ull, 10000000000000ull,
+    100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+    100000000000000000ull, 1000000000000000000ull,
+    10000000000000000000ull,
+};
+/// Move last digit down toward w while still inside the boundaries
+inline void GrisuRound(char* const buf, size_t const len, uint64_t const delta,
+    uint64_t rest, uint64_t const tenKappa, uint64_t const wpW) noexcept
+{
+    while (rest < wpW && delta - rest >= tenKappa &&
+        (rest + tenKappa < wpW || wpW - rest > rest + tenKappa - wpW)) {
+        --buf[len - 1];
+        rest += tenKappa;
+    }
+}
+/// Digits of W in (Mp - delta, Mp], K adjusted to their exponent
+inline size_t DigitGen(DiyFp const& W, DiyFp const& Mp, uint64_t delta,
+    char* const buf, int& K) noexcept
+{
+    DiyFp const one{ uint64_t(1) << -Mp.e, Mp.e };
+    uint64_t const wpW = (Mp - W).f;
+    uint32_t p1 = uint32_t(Mp.f >> -one.e);
+    uint64_t p2 = Mp.f & (one.f - 1);
+    int kappa = int(CountDigits(p1));
+    size_t len = 0;
+    while (kappa > 0) {
+        uint32_t const pow = uint32_t(kPow10[kappa - 1]);
+        uint32_t const d = p1 / pow;
+        p1 %= pow;
+        if (d || len) {
+            buf[len++] = char('0' + d);
+        }
+        --kappa;
+        uint64_t const rest = (uint64_t(p1) << -one.e) + p2;
+        if (rest <= delta) {
+            K += kappa;
+            GrisuRound(buf, len, delta, rest, kPow10[kappa] << -one.e, wpW);
+            return len;
+        }
+    }
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char const d = char(p2 >> -one.e);
+        if (d || len) {
+            buf[len++] = char('0' + d);
+        }
+        p2 &= one.f - 1;
+        --kappa;
+        if (p2 < delta) {
+            K += kappa;
+            int const i = -kappa;
+            GrisuRound(buf, len, delta, p2, one.f, i < 20 ? wpW * kPow10[i] : 0);
+            return len;
+        }
+    }
+}
+/**
+ * Digits of finite @a bits > 0 to @a buf, value is digits * 10^K
+ * @param mantissaBits stored mantissa bits, 52 double, 23 float
+ * @param bias exponent bias plus mantissa bits
+ */
+inline size_t Grisu2(uint64_t const bits, int const mantissaBits,
+    int const bias, char* const buf, int& K) noexcept
+{
+    uint64_t const hidden = uint64_t(1) << mantissaBits;
+    uint64_t const mantissa = bits & (hidden - 1);
+    int const biased = int(bits >> mantissaBits);
+    DiyFp const v = biased ? DiyFp{ mantissa | hidden, biased - bias } :
+        DiyFp{ mantissa, 1 - bias };
+    // Boundaries: halfway to neighbours, lower one closer at a power of 2
+    DiyFp const pl = Normalize(DiyFp{ (v.f << 1) + 1, v.e - 1 });
+    DiyFp mi = (hidden == v.f && biased > 1) ?
+        DiyFp{ (v.f << 2) - 1, v.e - 2 } : DiyFp{ (v.f << 1) - 1, v.e - 1 };
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+    DiyFp const c = GetCachedPower(pl.e, K);
+    DiyFp const W = Normalize(v) * c;
+    DiyFp Wp = pl * c;
+    DiyFp Wm = mi * c;
+    // Stay inside the boundaries after rounding of products
+    ++Wm.f;
+    --Wp.f;
+    return DigitGen(W, Wp, Wp.f - Wm.f, buf, K);
+}
+/// Place @a len digits of @a buf times 10^k like %g, all digits kept
+inline size_t Prettify(char* const buf, size_t const len, int const k) noexcept
+{
+    // Position of decimal point
+    int const kk = int(len) + k;
+    if (k >= 0 && kk <= 17) {
+        // 1200
+        ::memset(buf + len, '0', size_t(k));
+        return size_t(kk);
+    }
+    if (kk > 0 && kk <= 17) {
+        // 12.34
+        ::memmove(buf + kk + 1, buf + kk, len - size_t(kk));
+        buf[kk] = '.';
+        return len + 1;
+    }
+    if (kk > -4 && kk <= 0) {
+        // 0.00123
+        size_t const offset = size_t(2 - kk);
+        ::memmove(buf + offset, buf, len);
+        buf[0] = '0';
+        buf[1] = '.';
+        ::memset(buf + 2, '0', offset - 2);
+        return len + offset;
+    }
+    // 1.234e+56, exponent at least 2 digits
+    size_t n = 1;
+    if (len > 1) {
+        ::memmove(buf + 2, buf + 1, len - 1);
+        buf[1] = '.';
+        n = len + 1;
+    }
+    int exp = kk - 1;
+    buf[n++] = 'e';
+    if (exp < 0) {
+        buf[n++] = '-';
+        exp = -exp;
+    } else {
+        buf[n++] = '+';
+    }
+    if (exp >= 100) {
+        buf[n++] = char('0' + exp / 100);
+        exp %= 100;
+    }
+    ::memcpy(buf + n, kDigitPairs + exp * 2, 2);
+    return n + 2;
+}
+/// Shared by double and float: sign, zero, inf and nan then Grisu2
+inline size_t FormatBinaryFloat(char* const buf, uint64_t const bits,
+    int const totalBits, int const mantissaBits, int const bias) noexcept
+{
+    bool const negative = (bits >> (totalBits - 1)) & 1;
+    uint64_t const abs = bits & ((uint64_t(1) << (totalBits - 1)) - 1);
+    uint64_t const expMask = (uint64_t(1) << (totalBits - 1)) -
+        (uint64_t(1) << mantissaBits);
+    if ((abs & expMask) == expMask) {
+        if (abs != expMask) {
+            ::memcpy(buf, "nan", 3);
+            return 3;
+        }
+        if (negative) {
+            ::memcpy(buf, "-inf", 4);
+            return 4;
+        }
+        ::memcpy(buf, "inf", 3);
+        return 3;
+    }
+    char* p = buf;
+    if (negative) {
+        *p++ = '-';
+    }
+    if (!abs) {
+        *p++ = '0';
+        return size_t(p - buf);
+    }
+    int K = 0;
+    size_t const len = Grisu2(abs, mantissaBits, bias, p, K);
+    return size_t(p - buf) + Prettify(p, len, K);
+}
+}//namespace
+size_t FormatDouble(char* const buf, double const v) noexcept
+{
+    uint64_t bits;
+    ::memcpy(&bits, &v, sizeof(bits));
+    return FormatBinaryFloat(buf, bits, 64, 52, 1075);
+}
+size_t FormatFloat(char* const buf, float const v) noexcept
+{
+    uint32_t bits;
+    ::memcpy(&bits, &v, sizeof(bits));
+    return FormatBinaryFloat(buf, bits, 32, 23, 150);
+}
+void FormatBuffer::appendU64(uint64_t const v) noexcept
+{
+    this->commit(FormatU64(this->reserve(kFormatIntMaxLen), v));
+}
+void FormatBuffer::appendI64(int64_t const v) noexcept
+{
+    this->commit(FormatI64(this->reserve(kFormatIntMaxLen), v));
+}
+void FormatBuffer::appendDouble(double const v) noexcept
+{
+    this->commit(FormatDouble(this->reserve(kFormatFloatMaxLen), v));
+}
+void FormatBuffer::appendFloat(float const v) noexcept
+{
+    this->commit(FormatFloat(this->reserve(kFormatFloatMaxLen), v));
+}
+void FormatBuffer::appendPointer(void const* const v) noexcept
+{
+    // Same as binary records
+    char* const p = this->reserve(24);
+    int const n = ::snprintf(p, 24, "0x%llx",
+        static_cast<unsigned long long>(uintptr_t(v)));
+    if (n > 0) {
+        this->commit(size_t(n < 24 ? n : 23));
+    }
+}
+FormatBuffer& ThreadFormatBuffer() noexcept
+{
+    static thread_local FormatBuffer buffer;
+    return buffer;
+}
+char const* FormatCopyText(FormatBuffer& b, char const* f) noexcept
+{
+    if (!f) {
+        return nullptr;
+    }
+    char const* text = f;
+    for (; *f; ++f) {
+        if ('{' != f[0] && '}' != f[0]) {
+            continue;
+        }
+        // Brace: flush text before it
+        b.append(text, size_t(f - text));
+        if ('{' == f[0] && '}' == f[1]) {
+            return f + 2;
+        }
+        if (f[0] == f[1]) {
+            // "{{" or "}}"
+            ++f;
+        }
+        // Escaped or lone brace kept as one char
+        text = f;
+        b.append(*text++);
+    }
+    b.append(text, size_t(f - text));
+    return nullptr;
+}
+}//namespace log
+}//namespace cti
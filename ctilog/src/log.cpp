@@ -15,8 +15,15 @@
 #include <string.h>
 #include <time.h>
 #include <libgen.h>
+#include <unistd.h>
+#include <sched.h>
+#include <errno.h>
+#if defined __GLIBC__
+#include <execinfo.h>
+#endif
 #include <sstream>
 #include <atomic>
+#include <algorithm>
 #include "ctilog/log/file.hpp"
 namespace cti {
 namespace log
@@ -24,57 +31,183 @@ namespace log
 /// For debug
 LogLevel kLogLevel = LogLevel::Note;
 std::string Logger::defaultLogFile = kPrimaryDefaultLogFile;
-boost::shared_mutex Logger::instancesRwlock;
-std::map<std::string, boost::shared_ptr<Logger>> Logger::instances;
+std::atomic<Logger::Instances const*> Logger::instances(nullptr);
+std::mutex Logger::instancesMutex;
 Logger Logger::emptyLogger("");
+std::atomic<uint64_t> Logger::generation(1);
+Logger::InstancesKeeper::~InstancesKeeper()
+{
+    delete Logger::instances.exchange(nullptr);
+}
+Logger::InstancesKeeper Logger::instancesKeeper;
+
+static inline uint64_t MonotonicMs() noexcept
+{
+    timespec tp;
+    if (::clock_gettime(CLOCK_MONOTONIC_COARSE, &tp)) {
+        return 1;
+    }
+    return uint64_t(tp.tv_sec) * 1000 + uint64_t(tp.tv_nsec) / 1000000;
+}
+/**
+ * Timer to flush loggers which stop writing with data not flushed
+ * @note Defined after Logger::instancesKeeper, so stopped before loggers
+ * destroyed
+ */
+struct AgeFlusher {
+    ~AgeFlusher() {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->stop = true;
+            this->cond.notify_one();
+        }
+        if (this->thread.joinable()) {
+            this->thread.join();
+        }
+    }
+    /// Run now, e.g. for generations of a rotation to shift
+    void wake() noexcept {
+        this->cond.notify_one();
+    }
+    void start() noexcept {
+        std::call_once(this->started, [this]() {
+            try {
+                this->thread = std::thread(&AgeFlusher::run, this);
+            } catch (std::system_error const& e) {
+                std::cerr << "AgeFlusher: cannot start: " << e.what() << "\n";
+            }
+        });
+    }
+    void run() noexcept {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while (!this->stop) {
+            this->cond.wait_for(lock, std::chrono::milliseconds(kTickMs));
+            if (this->stop) {
+                break;
+            }
+            lock.unlock();
+            Logger::flushAgedLoggers(MonotonicMs());
+            lock.lock();
+        }
+    }
+    static constexpr uint32_t kTickMs = 50;
+    std::once_flag started;
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool stop{ false };
+    std::thread thread;
+};
+/// Bound to a reference by milliseconds, so defined
+constexpr uint32_t AgeFlusher::kTickMs;
+static AgeFlusher kAgeFlusher;
+void StartAgeFlusher() noexcept
+{
+    kAgeFlusher.start();
+}
+/// Suffix of a file renamed by rotation, before generations shifted
+constexpr char const* kRotatingSuffix = ".rotating";
+/// Logger::rotated bits, file renamed to .rotating and not shifted yet
+constexpr uint32_t kRotatedLog = 1;
+constexpr uint32_t kRotatedBinary = 2;
+void Logger::flushAgedLoggers(uint64_t const nowMs) noexcept
+{
+    EpochGuard epochGuard;
+    Instances const* const all = Logger::instances.load(std::memory_order_acquire);
+    if (!all) {
+        return;
+    }
+    for (auto const& it: *all) {
+        it.second->flushIfAged(nowMs);
+        it.second->shiftRotated();
+    }
+}
 
 Logger& Logger::hasLogger(std::string const& file) noexcept
 {
-    //lock
-    BoostScopedReadLock readLock(Logger::instancesRwlock);
+    Instances const* const all = Logger::instances.load(std::memory_order_acquire);
+    if (!all) {
+        return emptyLogger;
+    }
     //find the logger
-    auto it = Logger::instances.find(file);
-    if (it == Logger::instances.end()) {
+    auto it = all->find(file);
+    if (it == all->end()) {
         return emptyLogger;
     }
     return *(it->second);
 }
 
-Logger& Logger::getLogger(LogLevel const& spinOnceLogLevel, std::string const& path, Outputs const& outputs) noexcept
+Logger& Logger::getLogger(std::string const& path, Outputs const& outputs) noexcept
 {
-    std::string file;
-    if (path.empty()) {
-        file = Logger::defaultLogFile;
-    } else {
-        file = path;
-    }
-
-    auto& l = Logger::hasLogger(file);
-    if (&Logger::emptyLogger != &l) {
-        if (LogLevel::Unchange != spinOnceLogLevel) {
-            l.spinOnceLogLevel = spinOnceLogLevel;
+    std::string const& file = path.empty() ? Logger::defaultLogFile : path;
+    auto const config = [&outputs](Logger& l) {
+        if (!outputs.testFlag(Output::CoutOrCerr) &&
+            !outputs.testFlag(Output::File)) {
+            return;
         }
-        if (outputs.testFlag(Output::CoutOrCerr) || outputs.testFlag(Output::File)) {
-            l.outputs = outputs;
+        l.updateConfig([&outputs](Config& c) {
+            c.outputs = outputs;
+        });
+    };
+    {
+        EpochGuard epochGuard;
+        auto& l = Logger::hasLogger(file);
+        if (&Logger::emptyLogger != &l) {
+            config(l);
+            return l;
         }
-        return l;
     }
-    BoostScopedWriteLock writeLock(Logger::instancesRwlock);
-    auto const ret = boost::shared_ptr<Logger>(new Logger(file, outputs));
-    Logger::instances[file] = ret;
-    if (LogLevel::Unchange != spinOnceLogLevel) {
-        ret->spinOnceLogLevel = spinOnceLogLevel;
+    Instances const* old;
+    Logger* created;
+    {
+        std::unique_lock<std::mutex> lock(Logger::instancesMutex);
+        old = Logger::instances.load(std::memory_order_relaxed);
+        if (old) {
+            // Maybe created by another thread when waiting lock
+            auto const it = old->find(file);
+            if (it != old->end()) {
+                config(*(it->second));
+                return *(it->second);
+            }
+        }
+        auto const ret = boost::shared_ptr<Logger>(new Logger(file, outputs));
+        config(*ret);
+        Instances* const next = old ? new Instances(*old) : new Instances;
+        (*next)[file] = ret;
+        Logger::instances.store(next, std::memory_order_release);
+        Logger::bumpGeneration();
+        created = ret.get();
     }
-    if (outputs.testFlag(Output::CoutOrCerr) || outputs.testFlag(Output::File)) {
-        ret->outputs = outputs;
+    if (old) {
+        EpochRetire([old]() { delete old; });
     }
-    return *(ret);
+    return *created;
 }
 
 void Logger::releaseLogger(std::string const& file) noexcept
 {
-    BoostScopedWriteLock writeLock(Logger::instancesRwlock);
-    instances.erase(file);
+    Instances const* old;
+    {
+        std::unique_lock<std::mutex> lock(Logger::instancesMutex);
+        old = Logger::instances.load(std::memory_order_relaxed);
+        if (!old || old->end() == old->find(file)) {
+            return;
+        }
+        Instances* const next = new Instances(*old);
+        next->erase(file);
+        Logger::instances.store(next, std::memory_order_release);
+        Logger::bumpGeneration();
+    }
+    // Logger freed with old snapshot after in-flight users unpinned
+    EpochRetire([old]() { delete old; });
+}
+void LoggerHandle::refresh() noexcept
+{
+    EpochGuard epochGuard;
+    // Acquire pairs with bump, so level seen is not older than generation
+    uint64_t const gen = Logger::generation.load(std::memory_order_acquire);
+    this->logger = &Logger::getLogger();
+    this->logLevel = this->logger->getAcceptLevel();
+    this->generation = gen;
 }
 
 Logger::Logger(std::string const& path,Outputs const& outputs,int32_t const maxSize,bool const trunc) noexcept: path(path)
@@ -88,39 +221,223 @@ Logger::Logger(std::string const& path,Outputs const& outputs,int32_t const maxS
     if (!outputs) {
         return;
     }
-    this->outputs = outputs;
+    this->setOutputs(outputs);
 }
 Logger::~Logger() noexcept
 {
     this->finish();
+    delete this->appendCallback.load(std::memory_order_acquire);
 }
 void Logger::finish() noexcept
 {
     if (this->path.empty()) {
         return;
     }
+    this->stopAsync();
+    this->stopBinary();
+    this->stopFlightRecorder();
+    this->stopRing();
+    this->closeFile();
+    this->stopUring();
+    this->stopDirect();
+    this->shiftRotated();
+}
+void Logger::closeFile() noexcept
+{
     std::unique_lock<std::mutex> lock(Logger::writemutex);
     if (!this->log) {
         return;
     }
-    ::fflush(this->log);
+    this->endRepeats();
+    this->flushFile();
+    this->closeLog();
+}
+void Logger::closeLog() noexcept
+{
+    if (this->uring) {
+        // Writes in flight go to this file
+        this->uring->detach();
+    }
+    if (this->direct) {
+        this->direct->detach();
+    }
     ::fclose(this->log);
     this->log = nullptr;
 }
+FILE* Logger::openFile(char const* const mode) noexcept
+{
+    FILE* const f = ::fopen(this->path.c_str(), mode);
+    if (f) {
+        // Let stdio hold what flush policy allows
+        size_t const bufSize = this->flushPolicy.bytes > BUFSIZ ?
+            this->flushPolicy.bytes : BUFSIZ;
+        ::setvbuf(f, nullptr, _IOFBF, bufSize);
+        StartAgeFlusher();
+        if (this->uring) {
+            int const ret = this->uring->attach(this->path);
+            if (ret < 0) {
+                std::cerr << "Logger::openFile: io_uring cannot write log, "
+                    "stdio used: " << strerror(-ret) << "\n";
+            }
+        }
+        if (this->direct) {
+            int const ret = this->direct->attach(this->path);
+            if (ret < 0) {
+                std::cerr << "Logger::openFile: O_DIRECT cannot write log, "
+                    "stdio used: " << strerror(-ret) << "\n";
+            }
+        }
+    }
+    this->unflushed = 0;
+    this->unflushedSince = 0;
+    return f;
+}
+void Logger::flushFile() noexcept
+{
+    if (this->unflushed) {
+        if (this->uring && this->uring->isAttached()) {
+            // Handed to kernel, not waited
+            this->uring->submit();
+        } else if (this->direct && this->direct->isAttached()) {
+            this->direct->flush();
+        } else if (this->log) {
+            ::fflush(this->log);
+        }
+    }
+    this->unflushed = 0;
+    this->unflushedSince = 0;
+}
+void Logger::flush() noexcept
+{
+    if (this->path.empty()) {
+        return;
+    }
+    if (this->async.load(std::memory_order_acquire)) {
+        // Wait records queued before now written
+        uint64_t const target = this->asyncQueue->pushed();
+        while (this->asyncPopped.load(std::memory_order_acquire) < target
+            && this->async.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+    {
+        std::unique_lock<std::mutex> lock(this->writemutex);
+        this->flushFile();
+        if (this->uring) {
+            this->uring->drain();
+        }
+    }
+    std::unique_lock<std::mutex> lock(this->binMutex);
+    if (this->binLog) {
+        ::fflush(this->binLog);
+        this->binUnflushedSince = 0;
+    }
+}
+void Logger::flushIfAged(uint64_t const nowMs) noexcept
+{
+    uint32_t maxAgeMs;
+    {
+        std::unique_lock<std::mutex> lock(this->writemutex);
+        if (this->repeats && nowMs - this->repeatSince >= this->collapseHoldMs) {
+            this->writeRepeats();
+        }
+        maxAgeMs = this->flushPolicy.maxAgeMs;
+        if (this->unflushedSince && maxAgeMs &&
+            nowMs - this->unflushedSince >= maxAgeMs) {
+            this->flushFile();
+        }
+    }
+    if (!this->binary.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(this->binMutex);
+    if (this->binLog && this->binUnflushedSince && maxAgeMs &&
+        nowMs - this->binUnflushedSince >= maxAgeMs) {
+        ::fflush(this->binLog);
+        this->binUnflushedSince = 0;
+    }
+}
+void Logger::setCollapseRepeats(uint32_t const holdMs) noexcept
+{
+    std::unique_lock<std::mutex> lock(this->writemutex);
+    if (!holdMs) {
+        this->endRepeats();
+    }
+    this->collapseHoldMs = holdMs;
+}
+void Logger::setFlushPolicy(FlushPolicy const& flushPolicy) noexcept
+{
+    std::unique_lock<std::mutex> lock(this->writemutex);
+    this->flushPolicy = flushPolicy;
+    // Erro and Fata always flush at once
+    if (this->flushPolicy.level < LogLevel::Erro) {
+        this->flushPolicy.level = LogLevel::Erro;
+    }
+}
+Logger::FlushPolicy Logger::getFlushPolicy() const noexcept
+{
+    std::unique_lock<std::mutex> lock(this->writemutex);
+    return this->flushPolicy;
+}
+Logger::Config Logger::updateConfig(std::function<void(Config&)> const& change) noexcept
+{
+    uint64_t cur = this->config.load(std::memory_order_relaxed);
+    Config next;
+    do {
+        next = Config::unpack(cur);
+        change(next);
+    } while (!this->config.compare_exchange_weak(cur, next.pack(),
+        std::memory_order_acq_rel, std::memory_order_relaxed));
+    return next;
+}
 void Logger::setLogLevel(LogLevel const& logLevel) noexcept
 {
     if (logLevel >= LogLevel::Min && logLevel <= LogLevel::Max) {
-        this->logLevel = logLevel;
+        this->updateConfig([&logLevel](Config& c) {
+            c.logLevel = logLevel;
+        });
+        Logger::bumpGeneration();
     }
 }
 LogLevel Logger::toggleLogLevel() noexcept
 {
-    uint32_t lv = uint32_t(this->logLevel);
-    lv += 1;
-    if (lv > uint32_t(LogLevel::Max)) {
-        lv = uint32_t(LogLevel::Min);
+    Config const c = this->updateConfig([](Config& c) {
+        uint32_t lv = uint32_t(c.logLevel);
+        lv += 1;
+        if (lv > uint32_t(LogLevel::Max)) {
+            lv = uint32_t(LogLevel::Min);
+        }
+        c.logLevel = static_cast<LogLevel>(lv);
+    });
+    Logger::bumpGeneration();
+    return c.logLevel;
+}
+void Logger::setOutputs(Outputs const& o) noexcept
+{
+    this->updateConfig([&o](Config& c) {
+        c.outputs = o;
+    });
+}
+void Logger::setAppendCallback(AppendCallback const& ac) noexcept
+{
+    AppendCallback const* const next = ac ? new AppendCallback(ac) : nullptr;
+    AppendCallback const* const old = this->appendCallback.exchange(next,
+        std::memory_order_acq_rel);
+    if (old) {
+        EpochRetire([old]() { delete old; });
     }
-    return this->logLevel = static_cast<LogLevel>(lv);
+}
+void Logger::enableIdx(bool const enable) noexcept
+{
+    this->updateConfig([enable](Config& c) {
+        c.hasIdx = enable;
+    });
+}
+void Logger::enableTid(bool const enable) noexcept
+{
+    this->updateConfig([enable](Config& c) {
+        c.hasTid = enable;
+    });
 }
 //set file max size
 void Logger::setMaxSize(int32_t const maxSize) noexcept
@@ -133,6 +450,10 @@ void Logger::setMaxSize(int32_t const maxSize) noexcept
        }
    }
 }
+void Logger::setGenerations(uint32_t const generations) noexcept
+{
+    this->generations = generations ? generations : 1;
+}
 int64_t Logger::reset(bool const trunc) noexcept
 {
     // Skip empty logger
@@ -141,9 +462,9 @@ int64_t Logger::reset(bool const trunc) noexcept
     }
     {
         // Finish when not need Output::File
-        auto const o = this->outputs;
+        auto const o = this->loadConfig().outputs;
         if (!o.testFlag(Output::File)) {
-            this->finish();
+            this->closeFile();
             return 0;
         }
     }
@@ -151,9 +472,9 @@ int64_t Logger::reset(bool const trunc) noexcept
         std::unique_lock<std::mutex> lock(this->writemutex);
         if (this->log) {
             // Opened but means to open new => close old => always
-            ::fflush(this->log);
-            ::fclose(this->log);
-            this->log = nullptr;
+            this->endRepeats();
+            this->flushFile();
+            this->closeLog();
         }
         // Mkdir
         {
@@ -167,11 +488,7 @@ int64_t Logger::reset(bool const trunc) noexcept
             }
         }
         // open
-        if (trunc) {
-            this->log = ::fopen(this->path.c_str(), "wb");
-        } else {
-            this->log = ::fopen(this->path.c_str(), "ab");
-        }
+        this->log = this->openFile(trunc ? "wb" : "ab");
         if (!this->log) {
             // Open fail
             int ret = errno;
@@ -181,295 +498,1520 @@ int64_t Logger::reset(bool const trunc) noexcept
             }
             return -ret;
         }
+        // Reconcile size with what is on disk
+        struct stat st;
+        if (::fstat(::fileno(this->log), &st) < 0) {
+            this->fileSize = 0;
+        } else {
+            this->fileSize = uint64_t(st.st_size);
+        }
     } /* ScopedLock */
     // Final try limit log size ? X
     return 0;// OK
 }
-constexpr uint32_t kShrinkToFitInteval = 5;
-constexpr uint32_t kFlushInteval = 3;
-static std::atomic<uint64_t> kLogIdx(0);
-int Logger::append(char const* const name,char const* const file,int const line,std::string const& msg,LogLevel const& logLevel) noexcept
+static std::atomic<uint64_t> kLogIdx(0);
+/// Level tags in record header
+static constexpr char const* kLevelTags[] = {
+    "Fata(0)", "Erro(1)", "Warn(2)", "Note(3)",
+    "Info(4)", "Trac(5)", "Debu(6)", "Deta(7)",
+};
+static constexpr uint32_t kLevelTagLen = 7;
+/**
+ * Buffer to render one record, grows to the longest record of the thread and
+ * keeps it, so steady state does not allocate
+ */
+struct LineBuffer {
+    inline void clear() noexcept { this->len = 0; }
+    inline size_t size() const noexcept { return this->len; }
+    inline char* data() noexcept { return this->buf.data(); }
+    /// Write position, valid for bytes reserved
+    inline char* end() noexcept { return this->buf.data() + this->len; }
+    /// Make room for @a n more bytes
+    inline void reserve(size_t const n) {
+        if (this->len + n > this->buf.size()) {
+            size_t cap = this->buf.size() * 2;
+            if (cap < this->len + n) {
+                cap = this->len + n;
+            }
+            this->buf.resize(cap);
+        }
+    }
+    /// Count @a n bytes written at end()
+    inline void commit(size_t const n) noexcept { this->len += n; }
+    inline void append(char const c) {
+        this->reserve(1);
+        this->buf[this->len++] = c;
+    }
+    inline void append(char const* const s, size_t const n) {
+        this->reserve(n);
+        ::memcpy(this->end(), s, n);
+        this->len += n;
+    }
+    inline void appendU64(uint64_t const v) {
+        this->reserve(kFormatIntMaxLen);
+        this->commit(FormatU64(this->end(), v));
+    }
+    inline void appendLevel(LogLevel const& logLevel) {
+        uint32_t const lv = uint32_t(logLevel);
+        if (lv <= uint32_t(LogLevel::Max)) {
+            this->append(kLevelTags[lv], kLevelTagLen);
+        } else {
+            this->append("(unknown)(", 10);
+            this->appendU64(lv);
+            this->append(')');
+        }
+    }
+private:
+    std::vector<char> buf = std::vector<char>(4096);
+    size_t len{ 0 };
+};
+static thread_local LineBuffer kLineBuffer;
+/// Buffers of write() nested in an AppendCallback, made on first nesting
+constexpr uint32_t kNestedLineBuffers = 3;
+static thread_local std::unique_ptr<LineBuffer>
+    kNestedLineBuffer[kNestedLineBuffers];
+/// write() calls running in this thread
+static thread_local uint32_t kWriteDepth = 0;
+/**
+ * Line buffer of the write() being entered, its own per depth, as an
+ * AppendCallback logging again still holds the view of the outer line
+ */
+struct LineBufferGuard {
+    LineBufferGuard() noexcept {
+        uint32_t const depth = kWriteDepth++;
+        if (!depth) {
+            this->buffer = &kLineBuffer;
+            return;
+        }
+        std::unique_ptr<LineBuffer>& nested = depth <= kNestedLineBuffers ?
+            kNestedLineBuffer[depth - 1] : this->deep;
+        if (!nested) {
+            nested.reset(new (std::nothrow) LineBuffer);
+        }
+        this->buffer = nested.get();
+    }
+    ~LineBufferGuard() { --kWriteDepth; }
+    LineBufferGuard(LineBufferGuard const&) = delete;
+    LineBufferGuard& operator=(LineBufferGuard const&) = delete;
+    /// Null when out of memory
+    LineBuffer* buffer{ nullptr };
+private:
+    /// Deeper than kNestedLineBuffers, freed on return
+    std::unique_ptr<LineBuffer> deep;
+};
+/// Logger whose backend runs in current thread, to avoid queue to self
+static thread_local Logger const* kAsyncBackend = nullptr;
+LogLevel Logger::acceptLevel(LogLevel const& logLevel, Config& config) noexcept
+{
+    config = this->loadConfig();
+    if (config.logLevel < logLevel) {
+        return LogLevel::Unchange;
+    }
+    return logLevel;
+}
+int Logger::append(StringView const& name, char const* const file,
+    int const line, StringView const& msg, LogLevel const& logLevel) noexcept
+{
+    // In-flight, delay destroy after release
+    EpochGuard epochGuard;
+    if (this->path.empty()) {
+        return -EPERM;
+    }
+    Record record;
+    record.name = name.data();
+    record.nameLen = name.size();
+    record.file = file;
+    record.line = line;
+    record.msg = msg.data();
+    record.msgLen = msg.size();
+    LogLevel const lvl = this->acceptLevel(logLevel, record.config);
+    if (LogLevel::Unchange == lvl) {
+        return this->capture(record, logLevel);
+    }
+    // If not need
+    if (!record.config.outputs) {
+        return ENODEV;
+    }
+    record.level = lvl;
+    return this->dispatch(record);
+}
+int Logger::append(Callsite const& site, StringView const& msg) noexcept
+{
+    // In-flight, delay destroy after release
+    EpochGuard epochGuard;
+    if (this->path.empty()) {
+        return -EPERM;
+    }
+    Record record;
+    StringView const name = site.getName();
+    record.name = name.data();
+    record.nameLen = name.size();
+    record.site = &site;
+    record.msg = msg.data();
+    record.msgLen = msg.size();
+    LogLevel const lvl = this->acceptLevel(site.level, record.config);
+    if (LogLevel::Unchange == lvl) {
+        return this->capture(record, site.level);
+    }
+    if (!record.config.outputs) {
+        return ENODEV;
+    }
+    record.level = lvl;
+    return this->dispatch(record);
+}
+int Logger::append(StringView const& msg, LogLevel const& logLevel) noexcept
+{
+    // In-flight, delay destroy after release
+    EpochGuard epochGuard;
+    if (this->path.empty()) {
+        return -EPERM;
+    }
+    Record record;
+    record.msg = msg.data();
+    record.msgLen = msg.size();
+    record.raw = true;
+    LogLevel const lvl = this->acceptLevel(logLevel, record.config);
+    if (LogLevel::Unchange == lvl) {
+        return this->capture(record, logLevel);
+    }
+    if (!record.config.outputs) {
+        return ENODEV;
+    }
+    record.level = lvl;
+    return this->dispatch(record);
+}
+int Logger::dispatch(Record& record) noexcept
+{
+    record.idx = ++kLogIdx;
+    record.tid = uint64_t(::pthread_self());
+    if (::clock_gettime(CLOCK_REALTIME_COARSE, &record.time)) {
+        record.time = timespec{ 0, 0 };
+    }
+    if (this->async.load(std::memory_order_acquire) && kAsyncBackend != this) {
+        if (LogLevel::Fata == record.level) {
+            // Durable before return, so not left in queue
+            this->flush();
+        } else {
+            // Counted before async checked again, so stopAsync either waits
+            // this push or this sees async off and writes itself
+            this->asyncPushers.fetch_add(1, std::memory_order_seq_cst);
+            if (this->async.load(std::memory_order_seq_cst)) {
+                int const ret = this->asyncPush(record);
+                this->asyncPushers.fetch_sub(1, std::memory_order_release);
+                if (-ESHUTDOWN != ret) {
+                    return ret;
+                }
+            } else {
+                this->asyncPushers.fetch_sub(1, std::memory_order_release);
+            }
+        }
+    }
+    return this->write(record);
+}
+/// FNV-1a of name, level, callsite and msg, for repeat collapsing
+static inline uint64_t RecordHash(char const* const name, size_t const nameLen,
+    LogLevel const& level, Callsite const* const site, char const* const msg,
+    size_t const msgLen) noexcept
+{
+    uint64_t h = 14695981039346656037ull;
+    auto const mix = [&h](char const* p, size_t n) {
+        for (; n; --n, ++p) {
+            h = (h ^ uint8_t(*p)) * 1099511628211ull;
+        }
+    };
+    mix(name, nameLen);
+    char const sep[2] = { '\0', char(level) };
+    mix(sep, sizeof(sep));
+    // Same msg of two callsites differs by their suffix
+    mix(reinterpret_cast<char const*>(&site), sizeof(site));
+    mix(msg, msgLen);
+    // 0 means no last record
+    return h ? h : 1;
+}
+void Logger::writeRepeats() noexcept
+{
+    if (!this->repeats) {
+        return;
+    }
+    uint64_t const n = this->repeats;
+    this->repeats = 0;
+    if (!this->log && !this->ring) {
+        return;
+    }
+    timespec now;
+    if (::clock_gettime(CLOCK_REALTIME_COARSE, &now)) {
+        now = timespec{ 0, 0 };
+    }
+    char time[kLogRealTimeMaxLen];
+    uint32_t const timeLen = FormatLogRealTime(now, time);
+    uint32_t const lv = uint32_t(this->repeatLevel);
+    char line[kLogRealTimeMaxLen + 64];
+    int wrote = ::snprintf(line, sizeof(line),
+        "[%.*s %.*s] last message repeated %llu times\n", int(timeLen), time,
+        int(kLevelTagLen), lv <= uint32_t(LogLevel::Max) ? kLevelTags[lv] :
+        "Unknown", static_cast<unsigned long long>(n));
+    if (wrote <= 0) {
+        return;
+    }
+    wrote = std::min(wrote, int(sizeof(line)) - 1);
+    if (this->ring) {
+        this->ring->append(line, size_t(wrote));
+        return;
+    }
+    if (this->writeFile(line, size_t(wrote)) < 0) {
+        return;
+    }
+    this->fileSize += uint64_t(wrote);
+    this->unflushed += uint32_t(wrote);
+    if (!this->unflushedSince) {
+        this->unflushedSince = MonotonicMs();
+    }
+}
+int Logger::writeFile(char const* const data, size_t const len) noexcept
+{
+    if (this->uring && this->uring->isAttached()) {
+        return this->uring->write(data, len);
+    }
+    if (this->direct && this->direct->isAttached()) {
+        return this->direct->write(data, len);
+    }
+    if (::fwrite(data, 1, len, this->log) != len) {
+        return errno ? -errno : -EIO;
+    }
+    return 0;
+}
+void Logger::endRepeats() noexcept
+{
+    this->writeRepeats();
+    this->repeatHash = 0;
+}
+int Logger::write(Record const& record) noexcept
+{
+    auto const o = record.config.outputs;
+    if (!o) {
+        return ENODEV;
+    }
+    LogLevel const lvl = record.level;
+    int64_t ret = 0;
+    bool needRotate = false;
+    // Msg to write(append), reused per thread and depth
+    LineBufferGuard lineBuffer;
+    if (!lineBuffer.buffer) {
+        return -ENOMEM;
+    }
+    LineBuffer& w = *lineBuffer.buffer;
+    w.clear();
+    {
+        std::unique_lock<std::mutex> lock(this->writemutex);
+        // Reset log file when has file output and no log file
+        if (o.testFlag(Output::File) && !this->log && !this->ring) {
+            // Both lock writemutex themselves
+            lock.unlock();
+            if (this->reset(false) < 0) {
+                std::cerr << "Logger::append: Output has file but cannot get "
+                    "log\n";
+                if (!o.testFlag(Output::CoutOrCerr)) {
+                    // Done when file fail and no CoutOrCerr output
+                    return -EFAULT;
+                }
+            }
+            else {
+                // Fit when create
+                this->shrinkToFit();
+            }
+            lock.lock();
+        }
+        if (record.raw) {
+            w.append(record.msg, record.msgLen);
+        } else {
+            if (record.config.hasIdx) {
+                w.appendU64(record.idx);
+            }
+            w.append('[');
+            w.reserve(kLogRealTimeMaxLen);
+            w.commit(FormatLogRealTime(record.time, w.end()));
+            w.append(' ');
+            if (record.config.hasTid) {
+                w.appendU64(record.tid);
+                w.append(' ');
+            }
+            w.appendLevel(lvl);
+            w.append(']');
+            if (record.name) {
+                w.append('[');
+                w.append(record.name, record.nameLen);
+                w.append(']');
+            }
+            w.append(' ');
+            w.append(record.msg, record.msgLen);
+            if (record.site) {
+                StringView const suffix = record.site->getSuffix();
+                w.append(suffix.data(), suffix.size());
+            } else if (record.file) {
+                w.append(" (", 2);
+                w.append(record.file, ::strlen(record.file));
+                if (record.line >= 0) {
+                    w.append('+');
+                    w.appendU64(uint64_t(record.line));
+                }
+                w.append(')');
+            }
+        }
+        // Nul for console, replaced by newline for file
+        w.reserve(1);
+        *w.end() = '\0';
+        char const* const nl = record.raw ? "" : "\n";
+        if (o.testFlag(Output::CoutOrCerr)) {
+            switch (lvl) {
+            // Just color
+#           define LOGFALL(__fmt, __args...) \
+                fprintf(stdout, "\033[30;49m" __fmt "\033[0m%s", ##__args, nl)
+#           define LOGFFATA(__fmt, __args...) \
+                fprintf(stderr, "\033[1;31;49m" __fmt "\033[0m%s", ##__args, nl)
+#           define LOGFERRO(__fmt, __args...) \
+                fprintf(stderr, "\033[31;49m" __fmt "\033[0m%s", ##__args, nl)
+#           define LOGFWARN(__fmt, __args...) \
+                fprintf(stderr, "\033[33;49m" __fmt "\033[0m%s", ##__args, nl)
+#           define LOGFNOTE(__fmt, __args...) \
+                fprintf(stdout, "\033[1;30;49m" __fmt "\033[0m%s", ##__args, nl)
+#           define LOGFINFO(__fmt, __args...) \
+                fprintf(stdout, __fmt "%s", ##__args, nl)
+#           define LOGFTRAC(__fmt, __args...) \
+                fprintf(stdout, "\033[34;49m" __fmt "\033[0m%s", ##__args, nl)
+#           define LOGFDEBU(__fmt, __args...) \
+                fprintf(stdout, "\033[36;49m" __fmt "\033[0m%s", ##__args, nl)
+#           define LOGFDETA(__fmt, __args...) \
+                fprintf(stdout, __fmt "%s", ##__args, nl)
+            case LogLevel::Fata: LOGFFATA("%s", w.data()); break;
+            case LogLevel::Erro: LOGFERRO("%s", w.data()); break;
+            case LogLevel::Warn: LOGFWARN("%s", w.data()); break;
+            case LogLevel::Note: LOGFNOTE("%s", w.data()); break;
+            case LogLevel::Info: LOGFINFO("%s", w.data()); break;
+            case LogLevel::Trac: LOGFTRAC("%s", w.data()); break;
+            case LogLevel::Debu: LOGFDEBU("%s", w.data()); break;
+            case LogLevel::Deta: LOGFDETA("%s", w.data()); break;
+            default:             LOGFALL("%s", w.data()); break;
+#           undef LOGFALL
+#           undef LOGFFATA
+#           undef LOGFERRO
+#           undef LOGFWARN
+#           undef LOGFNOTE
+#           undef LOGFINFO
+#           undef LOGFTRAC
+#           undef LOGFDEBU
+#           undef LOGFDETA
+            }
+        }
+        if (o.testFlag(Output::File)) {
+            if (!this->log && !this->ring) {
+                ret = -ENOENT;
+                goto end;
+            }
+            if (this->collapseHoldMs && !record.raw) {
+                uint64_t const h = RecordHash(record.name, record.nameLen,
+                    lvl, record.site, record.msg, record.msgLen);
+                if (h == this->repeatHash) {
+                    if (!this->repeats++) {
+                        this->repeatSince = MonotonicMs();
+                    }
+                    goto end;
+                }
+                this->writeRepeats();
+                this->repeatHash = h;
+                this->repeatLevel = lvl;
+            }
+            size_t const lineLen = w.size();
+            size_t const toWrite = record.raw ? lineLen : lineLen + 1;
+            if (!record.raw) {
+                *w.end() = '\n';
+            }
+            if (this->ring) {
+                this->ring->append(w.data(), toWrite);
+                ret = int64_t(lineLen);
+                // Fata on disk before return, a crash may follow
+                if (LogLevel::Fata == lvl) {
+                    this->ring->sync();
+                }
+                goto end;
+            }
+            ret = this->writeFile(w.data(), toWrite);
+            if (ret < 0) {
+                goto end;
+            }
+            ret = int64_t(lineLen);
+            this->fileSize += toWrite;
+            this->unflushed += toWrite;
+            if (!this->unflushedSince) {
+                this->unflushedSince = MonotonicMs();
+            }
+            // Direct writes whole buffer when full, bytes would cut blocks
+            if ((this->unflushed >= this->flushPolicy.bytes &&
+                !(this->direct && this->direct->isAttached())) ||
+                lvl <= this->flushPolicy.level) {
+                this->flushFile();
+            }
+            // Fata on disk before return, a crash may follow; EINVAL when
+            // file cannot sync (e.g. a pipe)
+            if (LogLevel::Fata == lvl) {
+                if (this->uring) {
+                    this->uring->drain();
+                }
+                if (::fdatasync(::fileno(this->log)) < 0 && EINVAL != errno) {
+                    ret = -errno;
+                    goto end;
+                }
+            }
+            // Last rotation not shifted yet: not before max, see shrinkToFit
+            needRotate = this->fileSize > ((this->rotated.load(
+                std::memory_order_acquire) & kRotatedLog) ? this->maxSize :
+                this->maxSize / 2);
+        }
+    } /* ScopedLock */
+end:
+    if (ret < 0) {
+        this->reset(false);
+    } else if (needRotate) {
+        this->shrinkToFit();
+    }
+    // Callback when need, line passed as is from the line buffer
+    if (this->appendCallback.load(std::memory_order_relaxed)) {
+        this->tryDoAcCb(StringView(record.name ? record.name : "",
+            record.nameLen), lvl, StringView(w.data(), w.size()));
+    }
+    // Context of an error kept by flight recorder
+    if (lvl <= LogLevel::Erro && !record.raw &&
+        this->flightRecorder.load(std::memory_order_relaxed)) {
+        this->dumpFlightRecorder();
+    }
+    return ret;
+}
+//--Binary
+int Logger::startBinary() noexcept
+{
+    if (this->path.empty()) {
+        return -EPERM;
+    }
+    std::unique_lock<std::mutex> lock(this->binMutex);
+    if (this->binLog) {
+        return 0;
+    }
+    int const ret = this->openBinary("ab");
+    if (ret < 0) {
+        return ret;
+    }
+    this->binary.store(true, std::memory_order_release);
+    return 0;
+}
+void Logger::stopBinary() noexcept
+{
+    this->binary.store(false, std::memory_order_release);
+    std::unique_lock<std::mutex> lock(this->binMutex);
+    this->closeBinary();
+}
+int Logger::openBinary(char const* const mode) noexcept
+{
+    std::string const binPath = this->path + ".bin";
+    this->binLog = ::fopen(binPath.c_str(), mode);
+    if (!this->binLog) {
+        int const ret = -errno;
+        std::cerr << "Logger::openBinary: cannot open " << binPath << ": "
+            << strerror(-ret) << "\n";
+        return ret;
+    }
+    size_t const bufSize = this->flushPolicy.bytes > BUFSIZ ?
+        this->flushPolicy.bytes : BUFSIZ;
+    ::setvbuf(this->binLog, nullptr, _IOFBF, bufSize);
+    StartAgeFlusher();
+    struct stat st;
+    this->binSize = ::fstat(::fileno(this->binLog), &st) < 0 ? 0 :
+        uint64_t(st.st_size);
+    // Formats written again in each file, so every file decodes alone
+    this->binDefined.clear();
+    this->binUnflushedSince = 0;
+    if (!this->binSize) {
+        ::fwrite(kBinaryMagic, 1, sizeof(kBinaryMagic), this->binLog);
+        this->binSize = sizeof(kBinaryMagic);
+    }
+    return 0;
+}
+void Logger::closeBinary() noexcept
+{
+    if (!this->binLog) {
+        return;
+    }
+    ::fclose(this->binLog);
+    this->binLog = nullptr;
+    this->binUnflushedSince = 0;
+}
+template<typename T>
+static inline char* PutValue(char* const p, T const& v) noexcept
+{
+    ::memcpy(p, &v, sizeof(T));
+    return p + sizeof(T);
+}
+int Logger::writeBinary(BinaryFormat const& format, char const* const types,
+    char const* const args, size_t const argsLen) noexcept
+{
+    // In-flight, delay destroy after release
+    EpochGuard epochGuard;
+    if (this->path.empty()) {
+        return -EPERM;
+    }
+    Record record;
+    LogLevel const lvl = this->acceptLevel(format.level, record.config);
+    if (LogLevel::Unchange == lvl) {
+        return 0;
+    }
+    if (!this->binary.load(std::memory_order_acquire)) {
+        // Text mode, format now
+        if (!record.config.outputs) {
+            return ENODEV;
+        }
+        // Per thread buffer as Logger::format, write() renders the line to
+        // its own
+        ScopedFormatBuffer scoped;
+        FormatBuffer& msg = scoped.buffer();
+        RenderBinaryArgs(format.fmt, types, args, argsLen, msg);
+        record.name = format.name;
+        record.nameLen = format.name ? ::strlen(format.name) : 0;
+        record.file = format.file;
+        record.line = format.line;
+        record.msg = msg.data();
+        record.msgLen = msg.size();
+        record.level = lvl;
+        return this->dispatch(record);
+    }
+    uint32_t const id = format.getId();
+    timespec time;
+    if (::clock_gettime(CLOCK_REALTIME_COARSE, &time)) {
+        time = timespec{ 0, 0 };
+    }
+    char head[1 + kBinaryRecordHeadLen];
+    char* p = head;
+    *p++ = kBinaryRecordTag;
+    p = PutValue(p, id);
+    p = PutValue(p, uint64_t(++kLogIdx));
+    p = PutValue(p, uint64_t(::pthread_self()));
+    p = PutValue(p, int64_t(time.tv_sec));
+    p = PutValue(p, uint32_t(time.tv_nsec));
+    p = PutValue(p, uint32_t(argsLen));
+    std::unique_lock<std::mutex> lock(this->binMutex);
+    FILE* const f = this->binLog;
+    if (!f) {
+        return -ENOENT;
+    }
+    size_t written = 0;
+    if (id >= this->binDefined.size() || !this->binDefined[id]) {
+        // Format entry before first record using it
+        std::string def(1, kBinaryFormatTag);
+        char fixed[4 + 1 + 4];
+        char* q = fixed;
+        q = PutValue(q, id);
+        *q++ = char(format.level);
+        q = PutValue(q, int32_t(format.line));
+        def.append(fixed, sizeof(fixed));
+        for (char const* const str: { format.name, format.file, format.fmt,
+            types }) {
+            size_t const len = str ? ::strlen(str) : 0;
+            uint16_t const len16 = uint16_t(len > UINT16_MAX ? UINT16_MAX : len);
+            def.append(reinterpret_cast<char const*>(&len16), sizeof(len16));
+            def.append(str ? str : "", len16);
+        }
+        if (::fwrite_unlocked(def.data(), 1, def.size(), f) != def.size()) {
+            return -EIO;
+        }
+        if (id >= this->binDefined.size()) {
+            this->binDefined.resize(id + 1);
+        }
+        this->binDefined[id] = true;
+        written += def.size();
+    }
+    if (::fwrite_unlocked(head, 1, sizeof(head), f) != sizeof(head) ||
+        ::fwrite_unlocked(args, 1, argsLen, f) != argsLen) {
+        return -EIO;
+    }
+    written += sizeof(head) + argsLen;
+    this->binSize += written;
+    if (lvl <= LogLevel::Erro) {
+        ::fflush_unlocked(f);
+        this->binUnflushedSince = 0;
+    } else if (!this->binUnflushedSince) {
+        this->binUnflushedSince = MonotonicMs();
+    }
+    // Until last .bin.rotating shifted, .bin grows a little more; up to max
+    // size when age flusher is behind, then shifted here as shrinkToFit
+    bool const behind = this->rotated.load(std::memory_order_acquire) &
+        kRotatedBinary;
+    if (this->binSize > (behind ? this->maxSize : this->maxSize / 2)) {
+        // Generations as text log, each decodable alone as formats written
+        // again; only renamed here, shifted by age flusher
+        std::string const binPath = this->path + ".bin";
+        uint32_t const gens = this->generations;
+        std::string const rotated = binPath +
+            (gens > 1 ? kRotatingSuffix : ".1");
+        this->closeBinary();
+        if (behind) {
+            std::unique_lock<std::mutex> rotateLock(this->rotateMutex);
+            this->shiftRotatedLocked(kRotatedBinary);
+        }
+        if (::rename(binPath.c_str(), rotated.c_str()) < 0) {
+            std::cerr << "Logger::writeBinary: cannot rename " << binPath
+                << ": " << strerror(errno) << "\n";
+        } else if (gens > 1) {
+            this->rotated.fetch_or(kRotatedBinary, std::memory_order_release);
+            kAgeFlusher.wake();
+        }
+        if (this->openBinary("wb") < 0) {
+            this->binary.store(false, std::memory_order_release);
+        }
+    }
+    return int(written);
+}
+//--Flight recorder
+int Logger::capture(Record const& record, LogLevel const& logLevel) noexcept
+{
+    if (record.config.flightLevel < logLevel) {
+        return 0;
+    }
+    FlightRecorder* const recorder =
+        this->flightRecorder.load(std::memory_order_acquire);
+    if (!recorder) {
+        return 0;
+    }
+    StringView suffix;
+    // Slot text is shorter anyway
+    char fileLine[kFlightSlotSize];
+    if (record.site) {
+        suffix = record.site->getSuffix();
+    } else if (record.file) {
+        size_t const fileLen = ::strnlen(record.file,
+            sizeof(fileLine) - 4 - kFormatIntMaxLen);
+        char* p = fileLine;
+        *p++ = ' ';
+        *p++ = '(';
+        ::memcpy(p, record.file, fileLen);
+        p += fileLen;
+        if (record.line >= 0) {
+            *p++ = '+';
+            p += FormatU64(p, uint64_t(record.line));
+        }
+        *p++ = ')';
+        suffix = StringView(fileLine, size_t(p - fileLine));
+    }
+    recorder->capture(logLevel, StringView(record.name, record.nameLen),
+        StringView(record.msg, record.msgLen), suffix);
+    return 0;
+}
+int Logger::startFlightRecorder(size_t const bytes, LogLevel const& level) noexcept
+{
+    if (this->path.empty()) {
+        return -EPERM;
+    }
+    if (level < LogLevel::Min || level > LogLevel::Max) {
+        return -EINVAL;
+    }
+    std::unique_ptr<FlightRecorder> recorder(new (std::nothrow)
+        FlightRecorder(bytes));
+    if (!recorder || !recorder->valid()) {
+        return -ENOMEM;
+    }
+    FlightRecorder* expected = nullptr;
+    if (!this->flightRecorder.compare_exchange_strong(expected,
+        recorder.get(), std::memory_order_acq_rel)) {
+        return -EALREADY;
+    }
+    recorder.release();
+    this->updateConfig([&level](Config& c) {
+        c.flightLevel = level;
+    });
+    Logger::bumpGeneration();
+    return 0;
+}
+void Logger::stopFlightRecorder() noexcept
+{
+    this->updateConfig([](Config& c) {
+        c.flightLevel = LogLevel::Min;
+    });
+    Logger::bumpGeneration();
+    FlightRecorder* const recorder = this->flightRecorder.exchange(nullptr,
+        std::memory_order_acq_rel);
+    if (recorder) {
+        // Captures pinned before exchange may still write to it
+        EpochRetire([recorder]() { delete recorder; });
+    }
+}
+int64_t Logger::dumpFlightRecorder() noexcept
+{
+    EpochGuard epochGuard;
+    FlightRecorder* const recorder =
+        this->flightRecorder.load(std::memory_order_acquire);
+    if (!recorder) {
+        return -ENOENT;
+    }
+    std::unique_lock<std::mutex> lock(this->flightMutex);
+    std::string lines;
+    size_t const n = recorder->drain([&lines](FlightEntry const& e) {
+        char head[1 + kLogRealTimeMaxLen + 1 + kFormatIntMaxLen + 1];
+        char* p = head;
+        *p++ = '[';
+        p += FormatLogRealTime(timespec{ time_t(e.sec), long(e.nsec) }, p);
+        *p++ = ' ';
+        p += FormatU64(p, e.tid);
+        *p++ = ' ';
+        lines.append(head, size_t(p - head));
+        if (e.level <= uint8_t(LogLevel::Max)) {
+            lines.append(kLevelTags[e.level], kLevelTagLen);
+        }
+        lines += ']';
+        if (e.nameLen) {
+            lines += '[';
+            lines.append(e.text, e.nameLen);
+            lines += ']';
+        }
+        lines += ' ';
+        lines.append(e.text + e.nameLen, e.textLen - e.nameLen);
+        lines += '\n';
+    });
+    if (!n) {
+        return 0;
+    }
+    std::string const flightPath = this->path + ".flight";
+    FILE* f = ::fopen(flightPath.c_str(), "a");
+    struct stat st;
+    if (f && !::fstat(::fileno(f), &st) &&
+        uint64_t(st.st_size) > this->maxSize / 2) {
+        // One generation, as .bin
+        ::fclose(f);
+        if (::rename(flightPath.c_str(), (flightPath + ".1").c_str()) < 0) {
+            std::cerr << "Logger::dumpFlightRecorder: cannot rename "
+                << flightPath << ": " << strerror(errno) << "\n";
+        }
+        f = ::fopen(flightPath.c_str(), "w");
+    }
+    if (!f) {
+        int const ret = -errno;
+        std::cerr << "Logger::dumpFlightRecorder: cannot open " << flightPath
+            << ": " << strerror(-ret) << "\n";
+        return ret;
+    }
+    std::ostringstream head;
+    head << "-- flight recorder: " << n << " records, " <<
+        recorder->getDropped() << " dropped in all --\n";
+    std::string const h = head.str();
+    int64_t ret = int64_t(n);
+    if (::fwrite(h.data(), 1, h.size(), f) != h.size() ||
+        ::fwrite(lines.data(), 1, lines.size(), f) != lines.size()) {
+        ret = -EIO;
+    }
+    if (::fclose(f) && ret >= 0) {
+        ret = -errno;
+    }
+    return ret;
+}
+//--Ring
+int Logger::startRing(size_t const bytes) noexcept
+{
+    if (this->path.empty()) {
+        return -EPERM;
+    }
+    std::unique_lock<std::mutex> lock(this->writemutex);
+    if (this->ring) {
+        return -EALREADY;
+    }
+    std::unique_ptr<MmapRing> ring(new (std::nothrow) MmapRing);
+    if (!ring) {
+        return -ENOMEM;
+    }
+    int const ret = ring->open(this->path + ".ring", bytes);
+    if (ret < 0) {
+        return ret;
+    }
+    // Records so far, repeat count included, stay in log file
+    if (this->log) {
+        this->endRepeats();
+        this->flushFile();
+        this->closeLog();
+    }
+    this->ring = std::move(ring);
+    return 0;
+}
+void Logger::stopRing() noexcept
+{
+    std::unique_lock<std::mutex> lock(this->writemutex);
+    if (!this->ring) {
+        return;
+    }
+    this->endRepeats();
+    this->ring.reset();
+}
+bool Logger::isRing() const noexcept
+{
+    std::unique_lock<std::mutex> lock(this->writemutex);
+    return bool(this->ring);
+}
+//--Uring
+int Logger::startUring(uint32_t const buffers, uint32_t const bufferBytes)
+    noexcept
+{
+    if (this->path.empty()) {
+        return -EPERM;
+    }
+    std::unique_lock<std::mutex> lock(this->writemutex);
+    if (this->uring) {
+        return -EALREADY;
+    }
+    if (this->direct) {
+        return -EBUSY;
+    }
+    std::unique_ptr<UringWriter> uring(new (std::nothrow) UringWriter);
+    if (!uring) {
+        return -ENOMEM;
+    }
+    int const ret = uring->open(buffers, bufferBytes);
+    if (ret < 0) {
+        // No io_uring in kernel, stdio kept
+        return ret;
+    }
+    if (this->log) {
+        // What stdio holds goes before
+        ::fflush(this->log);
+        int const r = uring->attach(this->path);
+        if (r < 0) {
+            return r;
+        }
+    }
+    this->uring = std::move(uring);
+    return 0;
+}
+void Logger::stopUring() noexcept
+{
+    std::unique_lock<std::mutex> lock(this->writemutex);
+    if (!this->uring) {
+        return;
+    }
+    this->endRepeats();
+    this->uring->close();
+    this->uring.reset();
+    if (this->log) {
+        // Stdio position to the end written by io_uring
+        ::fseek(this->log, 0, SEEK_END);
+    }
+}
+bool Logger::isUring() const noexcept
+{
+    std::unique_lock<std::mutex> lock(this->writemutex);
+    return bool(this->uring);
+}
+//--Direct
+int Logger::startDirect(uint32_t const bufferBytes) noexcept
+{
+    if (this->path.empty()) {
+        return -EPERM;
+    }
+    std::unique_lock<std::mutex> lock(this->writemutex);
+    if (this->direct) {
+        return -EALREADY;
+    }
+    if (this->uring) {
+        return -EBUSY;
+    }
+    std::unique_ptr<DirectWriter> direct(new (std::nothrow) DirectWriter);
+    if (!direct) {
+        return -ENOMEM;
+    }
+    int const ret = direct->open(bufferBytes);
+    if (ret < 0) {
+        return ret;
+    }
+    if (this->log) {
+        // What stdio holds goes before
+        ::fflush(this->log);
+        int const r = direct->attach(this->path);
+        if (r < 0) {
+            // E.g. tmpfs, stdio kept
+            return r;
+        }
+    }
+    this->direct = std::move(direct);
+    return 0;
+}
+void Logger::stopDirect() noexcept
+{
+    std::unique_lock<std::mutex> lock(this->writemutex);
+    if (!this->direct) {
+        return;
+    }
+    this->endRepeats();
+    this->direct->close();
+    this->direct.reset();
+    if (this->log) {
+        // Stdio position to the end written directly
+        ::fseek(this->log, 0, SEEK_END);
+    }
+}
+bool Logger::isDirect() const noexcept
+{
+    std::unique_lock<std::mutex> lock(this->writemutex);
+    return bool(this->direct);
+}
+//--Async
+int Logger::startAsync(uint32_t const capacity, Backpressure const& backpressure) noexcept
 {
     if (this->path.empty()) {
         return -EPERM;
     }
-    LogLevel lvl = this->spinOnceLogLevel;
-    if (LogLevel::Unchange != lvl) {
-        this->spinOnceLogLevel = LogLevel::Unchange;
-        if (this->logLevel < lvl) {
-            return 0;
-        }
+    std::unique_lock<std::mutex> lock(this->asyncCtlMutex);
+    if (this->asyncThread.joinable()) {
+        return -EALREADY;
     }
-    else {
-        if (this->logLevel < logLevel) {
-            return 0;
-        }
-        lvl = logLevel;
+    if (!this->asyncQueue) {
+        // Keep first queue, producers may still hold it after a stop
+        this->asyncQueue.reset(new BoundedQueue<AsyncSlot>(capacity));
     }
-    // If not need
-    auto const o = this->outputs;
-    if (!o) {
-        return ENODEV;
+    this->backpressure = backpressure;
+    this->asyncStop.store(false, std::memory_order_release);
+    try {
+        this->asyncThread = std::thread(&Logger::asyncRun, this);
+    } catch (std::system_error const& e) {
+        std::cerr << "Logger::startAsync: cannot start backend: " << e.what()
+            << "\n";
+        return -e.code().value();
     }
-    // Reset log file when has file output and no log file
-    if (o.testFlag(Output::File)) {
-        if (!this->log) {
-            if (this->reset(false) < 0) {
-                std::cerr << "Logger::append: Output has file but cannot get "
-                    "log\n";
-                if (!o.testFlag(Output::CoutOrCerr)) {
-                    // Done when file fail and no CoutOrCerr output
-                    return -EFAULT;
+    this->async.store(true, std::memory_order_release);
+    return 0;
+}
+void Logger::stopAsync() noexcept
+{
+    std::unique_lock<std::mutex> lock(this->asyncCtlMutex);
+    if (!this->asyncThread.joinable()) {
+        return;
+    }
+    this->async.store(false, std::memory_order_seq_cst);
+    // Pushes begun before async off land in queue before last drain,
+    // backend still running so blocked ones get room
+    while (this->asyncPushers.load(std::memory_order_seq_cst)) {
+        std::this_thread::yield();
+    }
+    this->asyncStop.store(true, std::memory_order_release);
+    {
+        std::unique_lock<std::mutex> lock(this->asyncMutex);
+        this->asyncCond.notify_all();
+    }
+    this->asyncThread.join();
+    // Records pushed after backend last looked
+    auto const consume = [this](AsyncSlot& slot) {
+        this->write(slot.record);
+        this->asyncPopped.fetch_add(1, std::memory_order_release);
+    };
+    while (this->asyncQueue->tryPop(consume)) {}
+}
+int Logger::asyncPush(Record const& record) noexcept
+{
+    auto const fill = [&record](AsyncSlot& slot) {
+        slot.record = record;
+        // Name of a callsite lives as long as the callsite
+        if (record.name && !record.site) {
+            slot.name.assign(record.name, record.nameLen);
+            slot.record.name = slot.name.data();
+        }
+        if (record.file) {
+            slot.file.assign(record.file);
+            slot.record.file = slot.file.c_str();
+        }
+        slot.msg.assign(record.msg, record.msgLen);
+        slot.record.msg = slot.msg.data();
+    };
+    auto& queue = *this->asyncQueue;
+    if (!queue.tryPush(fill)) {
+        switch (this->backpressure) {
+        case Backpressure::DropNewest:
+            this->dropped.fetch_add(1, std::memory_order_relaxed);
+            return -ENOBUFS;
+        case Backpressure::OverwriteOldest:
+            while (!queue.tryPush(fill)) {
+                if (queue.tryPop([](AsyncSlot&) {})) {
+                    this->dropped.fetch_add(1, std::memory_order_relaxed);
+                    this->asyncPopped.fetch_add(1, std::memory_order_release);
                 }
             }
-            else {
-                // Fit when create
-                this->shrinkToFit();
+            break;
+        case Backpressure::Block:
+        default:
+            while (!queue.tryPush(fill)) {
+                if (this->asyncStop.load(std::memory_order_acquire)) {
+                    return -ESHUTDOWN;
+                }
+                // Park till backend takes one, pairs with fence in asyncRun
+                std::unique_lock<std::mutex> lock(this->asyncMutex);
+                this->asyncBlocked.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (!queue.tryPush(fill)) {
+                    // Timed in case of a missed notify
+                    this->asyncCond.wait_for(lock, std::chrono::milliseconds(10));
+                    this->asyncBlocked.fetch_sub(1, std::memory_order_relaxed);
+                    continue;
+                }
+                this->asyncBlocked.fetch_sub(1, std::memory_order_relaxed);
+                break;
             }
+            break;
         }
     }
-    // Append
-    ++kLogIdx;
-    int64_t ret;
-    // Msg to write(append)
-    std::string w;
-    {
-        std::unique_lock<std::mutex> lock(this->writemutex);
-        if (this->hasIdx) {
-            w += std::to_string(kLogIdx);
+    // Pairs with fence in asyncRun, wake only when backend sleeping;
+    // blocked producers share asyncCond, so all
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (this->asyncSleeping.load(std::memory_order_relaxed)) {
+        std::unique_lock<std::mutex> lock(this->asyncMutex);
+        this->asyncCond.notify_all();
+    }
+    return 0;
+}
+void Logger::asyncRun() noexcept
+{
+    kAsyncBackend = this;
+    auto& queue = *this->asyncQueue;
+    auto const consume = [this](AsyncSlot& slot) {
+        this->write(slot.record);
+        this->asyncPopped.fetch_add(1, std::memory_order_release);
+        // Room made, pairs with fence in asyncPush
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (this->asyncBlocked.load(std::memory_order_relaxed)) {
+            std::unique_lock<std::mutex> lock(this->asyncMutex);
+            this->asyncCond.notify_all();
         }
-        w += "[" + LogRealTime() + " ";
-        if (this->hasTid) {
-            w += std::to_string(uint64_t(::pthread_self())) + " ";
+    };
+    for (;;) {
+        bool got = false;
+        while (queue.tryPop(consume)) {
+            got = true;
         }
-        w += logLevelToString(lvl) + "]";
-        if (name) {
-            w += "[";
-            w += name;
-            w += "]";
+        if (got) {
+            continue;
         }
-        w += " " + msg;
-        if (file) {
-            w += " (";
-            w += file;
-            if (line >= 0) {
-                w += "+";
-                w += std::to_string(line);
-            }
-            w += ")";
+        if (this->asyncStop.load(std::memory_order_acquire)) {
+            while (queue.tryPop(consume)) {}
+            break;
         }
-        if (o.testFlag(Output::CoutOrCerr)) {
-            switch (lvl) {
-            // Just color
-#           define LOGFALL(__fmt, __args...) \
-                fprintf(stdout, "\033[30;49m" __fmt "\033[0m\n", ##__args)
-#           define LOGFFATA(__fmt, __args...) \
-                fprintf(stderr, "\033[1;31;49m" __fmt "\033[0m\n", ##__args)
-#           define LOGFERRO(__fmt, __args...) \
-                fprintf(stderr, "\033[31;49m" __fmt "\033[0m\n", ##__args)
-#           define LOGFWARN(__fmt, __args...) \
-                fprintf(stderr, "\033[33;49m" __fmt "\033[0m\n", ##__args)
-#           define LOGFNOTE(__fmt, __args...) \
-                fprintf(stdout, "\033[1;30;49m" __fmt "\033[0m\n", ##__args)
-#           define LOGFINFO(__fmt, __args...) \
-                fprintf(stdout, __fmt "\n", ##__args)
-#           define LOGFTRAC(__fmt, __args...) \
-                fprintf(stdout, "\033[34;49m" __fmt "\033[0m\n", ##__args)
-#           define LOGFDEBU(__fmt, __args...) \
-                fprintf(stdout, "\033[36;49m" __fmt "\033[0m\n", ##__args)
-#           define LOGFDETA(__fmt, __args...) \
-                fprintf(stdout, __fmt "\n", ##__args)
-            case LogLevel::Fata: LOGFFATA("%s", w.c_str()); break;
-            case LogLevel::Erro: LOGFERRO("%s", w.c_str()); break;
-            case LogLevel::Warn: LOGFWARN("%s", w.c_str()); break;
-            case LogLevel::Note: LOGFNOTE("%s", w.c_str()); break;
-            case LogLevel::Info: LOGFINFO("%s", w.c_str()); break;
-            case LogLevel::Trac: LOGFTRAC("%s", w.c_str()); break;
-            case LogLevel::Debu: LOGFDEBU("%s", w.c_str()); break;
-            case LogLevel::Deta: LOGFDETA("%s", w.c_str()); break;
-            default:             LOGFALL("%s", w.c_str()); break;
-#           undef LOGFALL
-#           undef LOGFFATA
-#           undef LOGFERRO
-#           undef LOGFWARN
-#           undef LOGFNOTE
-#           undef LOGFINFO
-#           undef LOGFTRAC
-#           undef LOGFDEBU
-#           undef LOGFDETA
-            }
-            ret = 0;
+        std::unique_lock<std::mutex> lock(this->asyncMutex);
+        this->asyncSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (queue.empty() && !this->asyncStop.load(std::memory_order_acquire)) {
+            // Timed in case of a missed notify
+            this->asyncCond.wait_for(lock, std::chrono::milliseconds(10));
         }
-        if (o.testFlag(Output::File)) {
-            if (!this->log) {
-                ret = -ENOENT;
-                goto end;
-            }
-            ret = ::fwrite(w.c_str(), 1, w.length(), this->log);
-            ::fwrite("\n", 1, 1, this->log);
-            if (0 == (kLogIdx % kFlushInteval)) {
-                ::fflush(this->log);
-            }
-            if (ret != int64_t(w.length())) {
-                ret = -errno;
-                if (!ret) {
-                    ret = -EIO;
-                }
-                goto end;
+        this->asyncSleeping.store(false, std::memory_order_relaxed);
+    }
+    kAsyncBackend = nullptr;
+}
+//--Crash
+/// Frames in crash record
+static constexpr int kCrashFrames = 64;
+static constexpr int kCrashLockTries = 1000;
+static constexpr int kCrashSignals[] = { SIGSEGV, SIGABRT, SIGBUS, SIGFPE };
+static constexpr char const* kCrashSignalNames[] = {
+    "SIGSEGV", "SIGABRT", "SIGBUS", "SIGFPE"
+};
+static constexpr size_t kCrashSignalCount =
+    sizeof(kCrashSignals) / sizeof(kCrashSignals[0]);
+/// Handlers replaced, under kCrashMutex, read by handler
+static struct sigaction kCrashOldActions[kCrashSignalCount];
+static std::mutex kCrashMutex;
+static bool kCrashInstalled = false;
+/// First crashing thread flushes, others only pass signal on
+static std::atomic<bool> kCrashing(false);
+/// Alternate stack of installing thread, a stack overflow has none left
+static char kCrashAltStack[64 * 1024];
+/// write(2) all of @a data, async-signal-safe
+static void CrashWrite(int const fd, char const* data, size_t len) noexcept
+{
+    while (len) {
+        ssize_t const n = ::write(fd, data, len);
+        if (n < 0) {
+            if (EINTR == errno) {
+                continue;
             }
+            return;
         }
-    } /* ScopedLock */
-end:
-    if (ret < 0) {
-        this->reset(false);
-    } else if (0 == (kLogIdx % kShrinkToFitInteval)) {
-        this->shrinkToFit();
+        data += n;
+        len -= size_t(n);
     }
-    // Callback when need
-    if (name) {
-        this->tryDoAcCb(name, lvl, w);
-    } else {
-        this->tryDoAcCb("", lvl, w);
+}
+/**
+ * Write what logger's own stdio @a f holds to @a fd, without its lock
+ * @note glibc only, reads FILE fields of its ABI; elsewhere nothing is
+ * written and the buffer is lost. Not for stdout/stderr, which any thread
+ * may be writing.
+ */
+#ifdef __GLIBC__
+static void CrashDrainStdio(FILE* const f, int const fd) noexcept
+{
+    char* const base = f->_IO_write_base;
+    char* const ptr = f->_IO_write_ptr;
+    if (base && ptr > base) {
+        CrashWrite(fd, base, size_t(ptr - base));
+        // Not written again by exit
+        f->_IO_write_ptr = base;
     }
-    return ret;
 }
-int Logger::append(std::string const& msg, LogLevel const& logLevel) noexcept
+#else
+static void CrashDrainStdio(FILE* const, int const) noexcept {}
+#endif
+/**
+ * try_lock @a mutex a while, false when held by someone stopped (crashed)
+ * @note Not on the POSIX async-signal-safe list, a best effort deviation:
+ * it never blocks, and without it a backend thread still writing could
+ * drain the same stdio buffer twice. When not taken, the holder may be
+ * inside fwrite on the same FILE: the buffer drained may be torn (a record
+ * cut or written twice), and the holder may move the pointers after us.
+ */
+static bool CrashTryLock(std::mutex& mutex) noexcept
 {
-    if (this->path.empty()) {
-        return -EPERM;
+    for (int i = 0; i < kCrashLockTries; ++i) {
+        if (mutex.try_lock()) {
+            return true;
+        }
+        ::sched_yield();
     }
-    LogLevel lvl = this->spinOnceLogLevel;
-    if (LogLevel::Unchange != lvl) {
-        this->spinOnceLogLevel = LogLevel::Unchange;
-        if (this->logLevel < lvl) {
-            return 0;
+    return false;
+}
+/**
+ * @struct CrashLine
+ * Fixed buffer to render a line in signal handler, cut when full
+ */
+struct CrashLine {
+    inline void append(char const* const p, size_t n) noexcept {
+        n = std::min(n, sizeof(this->buf) - this->len);
+        ::memcpy(this->buf + this->len, p, n);
+        this->len += n;
+    }
+    inline void append(char const* const p) noexcept {
+        this->append(p, ::strlen(p));
+    }
+    inline void appendU64(uint64_t const v) noexcept {
+        char d[kFormatIntMaxLen];
+        this->append(d, FormatU64(d, v));
+    }
+    inline void appendHex(uint64_t const v) noexcept {
+        char d[16];
+        size_t i = sizeof(d);
+        uint64_t x = v;
+        do {
+            d[--i] = "0123456789abcdef"[x & 0xf];
+            x >>= 4;
+        } while (x);
+        this->append("0x", 2);
+        this->append(d + i, sizeof(d) - i);
+    }
+    /// sec.nnnnnnnnn, FormatLogRealTime is not async-signal-safe
+    inline void appendTime(timespec const& t) noexcept {
+        this->appendU64(uint64_t(t.tv_sec));
+        char d[10] = { '.' };
+        uint64_t ns = uint64_t(t.tv_nsec);
+        for (int i = 9; i > 0; --i, ns /= 10) {
+            d[i] = char('0' + ns % 10);
         }
+        this->append(d, sizeof(d));
     }
-    else {
-        if (this->logLevel < logLevel) {
-            return 0;
+    char buf[4096];
+    size_t len{ 0 };
+};
+int Logger::installCrashHandlers() noexcept
+{
+    std::unique_lock<std::mutex> lock(kCrashMutex);
+    if (kCrashInstalled) {
+        return -EALREADY;
+    }
+#if defined __GLIBC__
+    // First backtrace loads libgcc, which allocates, so not in handler
+    void* frame;
+    ::backtrace(&frame, 1);
+#endif
+    stack_t ss;
+    if (!::sigaltstack(nullptr, &ss) && (ss.ss_flags & SS_DISABLE)) {
+        ss.ss_sp = kCrashAltStack;
+        ss.ss_size = sizeof(kCrashAltStack);
+        ss.ss_flags = 0;
+        ::sigaltstack(&ss, nullptr);
+    }
+    struct sigaction sa;
+    ::memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = &Logger::onCrashSignal;
+    sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    ::sigemptyset(&sa.sa_mask);
+    for (size_t i = 0; i < kCrashSignalCount; ++i) {
+        if (::sigaction(kCrashSignals[i], &sa, &kCrashOldActions[i]) < 0) {
+            int const ret = -errno;
+            while (i--) {
+                ::sigaction(kCrashSignals[i], &kCrashOldActions[i], nullptr);
+            }
+            return ret;
         }
-        lvl = logLevel;
     }
-    auto const o = this->outputs;
-    if (!o) {
-        return ENODEV;
+    kCrashInstalled = true;
+    return 0;
+}
+void Logger::uninstallCrashHandlers() noexcept
+{
+    std::unique_lock<std::mutex> lock(kCrashMutex);
+    if (!kCrashInstalled) {
+        return;
     }
-    {
-        std::unique_lock<std::mutex> lock(this->writemutex);
-        if (o.testFlag(Output::File) && !o.testFlag(Output::CoutOrCerr)
-            && !this->log) {
-            std::cerr << "Logger::append: only output file enabled but no "
-                "log file \n";
-            return -ENOENT;
+    for (size_t i = 0; i < kCrashSignalCount; ++i) {
+        ::sigaction(kCrashSignals[i], &kCrashOldActions[i], nullptr);
+    }
+    kCrashInstalled = false;
+}
+void Logger::onCrashSignal(int const sig, siginfo_t* const info,
+    void* const context) noexcept
+{
+    int const savedErrno = errno;
+    size_t idx = 0;
+    while (idx < kCrashSignalCount && kCrashSignals[idx] != sig) {
+        ++idx;
+    }
+    if (!kCrashing.exchange(true)) {
+        void* frames[kCrashFrames];
+        int frameCount = 0;
+#if defined __GLIBC__
+        frameCount = ::backtrace(frames, kCrashFrames);
+#endif
+        timespec now;
+        if (::clock_gettime(CLOCK_REALTIME, &now)) {
+            now = timespec{ 0, 0 };
         }
-        if (o.testFlag(Output::CoutOrCerr)) {
-            switch (lvl) {
-            // Just color
-#           define LOGFALL(__fmt, __args...) \
-                fprintf(stdout, "\033[30;49m" __fmt "\033[0m", ##__args)
-#           define LOGFFATA(__fmt, __args...) \
-                fprintf(stderr, "\033[1;31;49m" __fmt "\033[0m", ##__args)
-#           define LOGFERRO(__fmt, __args...) \
-                fprintf(stderr, "\033[31;49m" __fmt "\033[0m", ##__args)
-#           define LOGFWARN(__fmt, __args...) \
-                fprintf(stderr, "\033[33;49m" __fmt "\033[0m", ##__args)
-#           define LOGFNOTE(__fmt, __args...) \
-                fprintf(stdout, "\033[1;30;49m" __fmt "\033[0m", ##__args)
-#           define LOGFINFO(__fmt, __args...) \
-                fprintf(stdout, __fmt, ##__args)
-#           define LOGFTRAC(__fmt, __args...) \
-                fprintf(stdout, "\033[34;49m" __fmt "\033[0m", ##__args)
-#           define LOGFDEBU(__fmt, __args...) \
-                fprintf(stdout, "\033[36;49m" __fmt "\033[0m", ##__args)
-#           define LOGFDETA(__fmt, __args...) \
-                fprintf(stdout, __fmt, ##__args)
-            case LogLevel::Fata: LOGFFATA("%s", msg.c_str()); break;
-            case LogLevel::Erro: LOGFERRO("%s", msg.c_str()); break;
-            case LogLevel::Warn: LOGFWARN("%s", msg.c_str()); break;
-            case LogLevel::Note: LOGFNOTE("%s", msg.c_str()); break;
-            case LogLevel::Info: LOGFINFO("%s", msg.c_str()); break;
-            case LogLevel::Trac: LOGFTRAC("%s", msg.c_str()); break;
-            case LogLevel::Debu: LOGFDEBU("%s", msg.c_str()); break;
-            case LogLevel::Deta: LOGFDETA("%s", msg.c_str()); break;
-            default:             LOGFALL("%s", msg.c_str()); break;
-#           undef LOGFALL
-#           undef LOGFFATA
-#           undef LOGFERRO
-#           undef LOGFWARN
-#           undef LOGFNOTE
-#           undef LOGFINFO
-#           undef LOGFTRAC
-#           undef LOGFDEBU
-#           undef LOGFDETA
-            }
+        CrashLine head;
+        head.append("[", 1);
+        head.appendTime(now);
+        head.append(" ", 1);
+        head.appendU64(uint64_t(::pthread_self()));
+        head.append(" ", 1);
+        head.append(kLevelTags[uint32_t(LogLevel::Fata)], kLevelTagLen);
+        head.append("][crash] signal ");
+        head.appendU64(uint64_t(sig));
+        if (idx < kCrashSignalCount) {
+            head.append(" ", 1);
+            head.append(kCrashSignalNames[idx]);
         }
-        if (o.testFlag(Output::File)) {
-            if (!this->log) {
-                return -ENOENT;
+        if (info && SIGABRT != sig) {
+            head.append(" at ");
+            head.appendHex(uint64_t(uintptr_t(info->si_addr)));
+        }
+        head.append(", backtrace:\n");
+        CrashWrite(STDERR_FILENO, head.buf, head.len);
+#if defined __GLIBC__
+        ::backtrace_symbols_fd(frames, frameCount, STDERR_FILENO);
+#endif
+        // No EpochGuard, loggers are not released in a crash
+        Instances const* const all =
+            Logger::instances.load(std::memory_order_acquire);
+        if (all) {
+            for (auto const& it: *all) {
+                it.second->crashFlush(head.buf, head.len, frames, frameCount);
             }
-            int64_t ret = ::fwrite(msg.c_str(), 1, msg.length(), this->log);
-            if (0 == (kLogIdx % kFlushInteval)) {
-                ::fflush(this->log);
+        }
+    }
+    errno = savedErrno;
+    // Pass on to handler replaced
+    if (idx < kCrashSignalCount) {
+        struct sigaction const& old = kCrashOldActions[idx];
+        if (old.sa_flags & SA_SIGINFO) {
+            if (old.sa_sigaction) {
+                old.sa_sigaction(sig, info, context);
+                return;
             }
-            if (ret != int64_t(msg.length())) {
-                ret = -errno;
-                if (!ret) {
-                    ret = -EIO;
-                }
-                return ret;
+        } else if (SIG_DFL != old.sa_handler && SIG_IGN != old.sa_handler) {
+            old.sa_handler(sig);
+            return;
+        }
+    }
+    // Default action, raised again when handler returns as sig is blocked
+    struct sigaction dfl;
+    ::memset(&dfl, 0, sizeof(dfl));
+    dfl.sa_handler = SIG_DFL;
+    ::sigemptyset(&dfl.sa_mask);
+    ::sigaction(sig, &dfl, nullptr);
+    ::raise(sig);
+}
+void Logger::crashWriteRecord(int const fd, Record const& record) noexcept
+{
+    auto const out = [this, fd](CrashLine const& line) {
+        if (this->ring) {
+            this->ring->append(line.buf, line.len);
+        } else {
+            CrashWrite(fd, line.buf, line.len);
+        }
+    };
+    CrashLine line;
+    if (record.raw) {
+        line.append(record.msg, record.msgLen);
+        out(line);
+        return;
+    }
+    if (record.config.hasIdx) {
+        line.appendU64(record.idx);
+    }
+    line.append("[", 1);
+    line.appendTime(record.time);
+    line.append(" ", 1);
+    if (record.config.hasTid) {
+        line.appendU64(record.tid);
+        line.append(" ", 1);
+    }
+    uint32_t const lv = uint32_t(record.level);
+    line.append(lv <= uint32_t(LogLevel::Max) ? kLevelTags[lv] : "Unknown",
+        kLevelTagLen);
+    line.append("]", 1);
+    if (record.name) {
+        line.append("[", 1);
+        line.append(record.name, record.nameLen);
+        line.append("]", 1);
+    }
+    line.append(" ", 1);
+    line.append(record.msg, record.msgLen);
+    // Suffix of callsite may be not rendered yet, which allocates
+    char const* const file = record.site ? record.site->file : record.file;
+    int const l = record.site ? record.site->line : record.line;
+    if (file) {
+        line.append(" (", 2);
+        line.append(file);
+        if (l >= 0) {
+            line.append("+", 1);
+            line.appendU64(uint64_t(l));
+        }
+        line.append(")", 1);
+    }
+    // Newline kept when cut
+    if (line.len == sizeof(line.buf)) {
+        --line.len;
+    }
+    line.append("\n", 1);
+    out(line);
+}
+void Logger::crashFlush(char const* const head, size_t const headLen,
+    void* const* const frames, int const frameCount) noexcept
+{
+    // Keep backend out while buffer drained, but crashed thread may hold it
+    bool const locked = CrashTryLock(this->writemutex);
+    FILE* const f = this->log;
+    int const fd = f ? ::fileno(f) : -1;
+    if (this->uring) {
+        // At own offsets, before appends below extend the file
+        this->uring->crashFlush();
+    }
+    if (this->direct) {
+        this->direct->crashFlush();
+    }
+    if (fd >= 0) {
+        CrashDrainStdio(f, fd);
+    }
+    if (this->async.load(std::memory_order_acquire) && this->asyncQueue) {
+        auto const consume = [this, fd](AsyncSlot& slot) {
+            if ((fd >= 0 || this->ring) &&
+                slot.record.config.outputs.testFlag(Output::File)) {
+                this->crashWriteRecord(fd, slot.record);
             }
+            this->asyncPopped.fetch_add(1, std::memory_order_release);
+        };
+        while (this->asyncQueue->tryPop(consume)) {}
+    }
+    if (fd >= 0) {
+        CrashWrite(fd, head, headLen);
+#if defined __GLIBC__
+        ::backtrace_symbols_fd(frames, frameCount, fd);
+#else
+        (void)frames;
+        (void)frameCount;
+#endif
+        ::fdatasync(fd);
+    }
+    // Mapping written back by kernel, no sync
+    if (this->ring) {
+        CrashLine bt;
+        bt.append(head, headLen);
+        for (int i = 0; i < frameCount; ++i) {
+            bt.append("  ", 2);
+            bt.appendHex(uint64_t(uintptr_t(frames[i])));
+            bt.append("\n", 1);
         }
-    } /* ScopedLock */
-    // Callback when need
-    this->tryDoAcCb("", lvl, msg);
-    return 0;
+        this->ring->append(bt.buf, bt.len);
+    }
+    if (locked) {
+        this->writemutex.unlock();
+    }
+    bool const binLocked = CrashTryLock(this->binMutex);
+    FILE* const b = this->binLog;
+    int const bfd = b ? ::fileno(b) : -1;
+    if (bfd >= 0) {
+        CrashDrainStdio(b, bfd);
+        ::fdatasync(bfd);
+    }
+    if (binLocked) {
+        this->binMutex.unlock();
+    }
+}
+//--AcNameFilter
+/// First of sorted @a filters not less than @a name
+static inline std::vector<std::string>::const_iterator AcNameFilterBound(
+    std::vector<std::string> const& filters, StringView const& name) noexcept
+{
+    return std::lower_bound(filters.begin(), filters.end(), name,
+        [](std::string const& a, StringView const& b) {
+            return StringView(a) < b;
+        });
+}
+static inline bool HasAcNameFilter(std::vector<std::string> const& filters,
+    StringView const& name) noexcept
+{
+    auto const it = AcNameFilterBound(filters, name);
+    return filters.end() != it && StringView(*it) == name;
 }
-void Logger::tryDoAcCb(std::string const& name, LogLevel const& logLevel, std::string const &msg) const noexcept
+void Logger::tryDoAcCb(StringView const& name, LogLevel const& logLevel,
+    StringView const& msg) const noexcept
 {
-    if (auto const ac = this->appendCallback)
+    // Pinned, callback replaced meanwhile not freed before return
+    EpochGuard epochGuard;
+    if (auto const ac = this->appendCallback.load(std::memory_order_acquire))
     {
         {
             BoostScopedReadLock readLock(this->acNameFiltersRwlock);
-            if (this->acNameFilters.empty()) {
-                return;
-            }
-            if (this->acNameFilters.cend() == this->acNameFilters.find(name)) {
+            if (!HasAcNameFilter(this->acNameFilters, name)) {
                 return;
             }
         }
         try {
-            ac(name, logLevel, msg);
+            (*ac)(name, logLevel, msg);
         } catch(...) {}
     }
 }
-//--AcNameFilter
 std::set<std::string> Logger::getAcNameFilters() const noexcept
 {
     BoostScopedReadLock readLock(this->acNameFiltersRwlock);
-    return this->acNameFilters;
+    return std::set<std::string>(this->acNameFilters.begin(),
+        this->acNameFilters.end());
 }
-bool Logger::hasAcNameFilter(std::string const& acNameFilter) const noexcept
+bool Logger::hasAcNameFilter(StringView const& acNameFilter) const noexcept
 {
     BoostScopedReadLock readLock(this->acNameFiltersRwlock);
-    return this->acNameFilters.cend() != this->acNameFilters.find(acNameFilter);
+    return HasAcNameFilter(this->acNameFilters, acNameFilter);
 }
-bool Logger::addAcNameFilter(std::string const& acNameFilter) noexcept
+bool Logger::addAcNameFilter(StringView const& acNameFilter) noexcept
 {
     BoostScopedWriteLock writeLock(this->acNameFiltersRwlock);
-    if (this->acNameFilters.end() != this->acNameFilters.find(acNameFilter)) {
+    auto const it = AcNameFilterBound(this->acNameFilters, acNameFilter);
+    if (this->acNameFilters.end() != it && StringView(*it) == acNameFilter) {
         return false;
     }
-    this->acNameFilters.insert(acNameFilter);
+    this->acNameFilters.insert(it, acNameFilter);
     return true;
 }
-bool Logger::removeAcNameFilter(std::string const& acNameFilter) noexcept
+bool Logger::removeAcNameFilter(StringView const& acNameFilter) noexcept
 {
     BoostScopedWriteLock writeLock(this->acNameFiltersRwlock);
-    if (this->acNameFilters.end() == this->acNameFilters.find(acNameFilter)) {
+    auto const it = AcNameFilterBound(this->acNameFilters, acNameFilter);
+    if (this->acNameFilters.end() == it || StringView(*it) != acNameFilter) {
         return false;
     }
-    this->acNameFilters.erase(acNameFilter);
+    this->acNameFilters.erase(it);
     return true;
 }
 void Logger::clearAcNameFilters() noexcept
@@ -582,96 +2124,109 @@ void Logger::shrinkToFit() noexcept
     if (this->path.empty()) {
         return;
     }
-    std::string tmpFilename;
+    // Another thread rotating, just skip
+    std::unique_lock<std::mutex> rotateLock(this->rotateMutex, std::try_to_lock);
+    if (!rotateLock) {
+        return;
+    }
+    uint32_t const gens = this->generations;
     {
         std::unique_lock<std::mutex> lock(this->writemutex);
         // Chk if no log
         if (!this->log) {
             return;
         }
-        off_t const size = GetFileSize(this->path); //文件大小
-        if (size < 0) {
-            // Fail ignore
-            std::cerr << "Logger::shrinkToFit:  GetFileSize fail\n";
-            return;
-        }
-        if (static_cast<uint64_t>(size) <= this->maxSize/2) {
+        if (this->fileSize <= this->maxSize/2) {
             return;
         }
-        std::cout << "Logger::shrinkToFit: will limitSize " << size << " to half of max " << this->maxSize << "\n";
-        ::fflush(this->log);
-        // Open to read last maxSize / 2 bytes
-        log::File currentLog(this->path);
-        int32_t code = currentLog.open(FileOpenConfig{PosixFileAccessMode::ReadOnly});
-        if (code < 0) {
-            std::cerr << "Logger::shrinkToFit: cannot open log file: " << code << "\n";
+        // Until last .rotating shifted, log grows a little more; up to max
+        // size when age flusher is behind (e.g. no CPU), then shifted here
+        bool const behind = this->rotated.load(std::memory_order_acquire) &
+            kRotatedLog;
+        if (behind && this->fileSize <= this->maxSize) {
             return;
         }
-        // Jump to last begin
-        currentLog.jump2Begin();
-        // Open a tmp file to save old file last: max / 2 bytes
-        tmpFilename = this->path + ".1";
-        PosixFileModes modes(0644);
-        log::File tmpFile(tmpFilename);
-        if(IsExists(tmpFilename)){
-            RemoveFiles(tmpFilename);
+        // Count stays with records it belongs to
+        this->endRepeats();
+        this->flushFile();
+        if (behind) {
+            this->shiftRotatedLocked(kRotatedLog);
         }
-        if (tmpFile.open(FileOpenConfig{PosixFileAccessMode::ReadWrite,SimplifiedFileOpenFlag::Create,&modes}) < 0) {
-            std::cerr << "Logger::shrinkToFit: cannot open tmp file: " << tmpFilename << "\n";
+        // One generation: replace path.1 directly, else shift later
+        std::string const rotated = this->path +
+            (gens > 1 ? kRotatingSuffix : ".1");
+        if (::rename(this->path.c_str(), rotated.c_str()) < 0) {
+            std::cerr << "Logger::shrinkToFit: cannot rename log to "
+                << rotated << ": " << strerror(errno) << "\n";
             return;
         }
-        // Copy
-        auto const doWrite2Tmp = [&code, &tmpFile](uint8_t const* const data,
-            uint32_t const size) -> bool {
-            uint64_t w;
-            std::tie(code, w) = tmpFile.write(data, size);
-            if (code < 0) {
-                std::cerr << "Logger::shrinkToFit: write fail!\n";
-                return true;// Done
-            } else {
-                return false;
-            }
-        };
-        uint64_t wroteBytes;
-        std::tie(code, wroteBytes) = currentLog.traverse(doWrite2Tmp, kBigPerReadBytes, this->maxSize);
-        currentLog.close();
-        tmpFile.close();
-        if (code >= 0) {
-            if(::fclose(this->log) < 0){
-                ::fclose(this->log);
-            }
-            this->log = nullptr;
-            // New log
-            FILE* newLog = ::fopen(this->path.c_str(), "wb");
-            if (!newLog) {
-                std::cerr << "Logger::shrinkToFit: cannot open log\n";
-                newLog = ::fopen(this->path.c_str(), "wb");
-                if(!newLog){
-                    return;
-                }
-            }
-            // Done
-            this->log = newLog;
+        this->closeLog();
+        // New log
+        this->fileSize = 0;
+        this->log = this->openFile("wb");
+        if (!this->log) {
+            std::cerr << "Logger::shrinkToFit: cannot open log\n";
+            return;
         }
     } // ScopedLock
+    if (gens > 1) {
+        // Unlink and renames of generations off the appending thread
+        this->rotated.fetch_or(kRotatedLog, std::memory_order_release);
+        kAgeFlusher.wake();
+    }
+}
+void Logger::shiftRotated() noexcept
+{
+    if (!this->rotated.load(std::memory_order_acquire)) {
+        return;
+    }
+    // Age flusher or finish, one shift at a time
+    std::unique_lock<std::mutex> rotateLock(this->rotateMutex);
+    this->shiftRotatedLocked(this->rotated.load(std::memory_order_acquire));
+}
+void Logger::shiftRotatedLocked(uint32_t const rotated) noexcept
+{
+    if (rotated & kRotatedLog) {
+        this->shiftGenerations(this->path);
+    }
+    if (rotated & kRotatedBinary) {
+        this->shiftGenerations(this->path + ".bin");
+    }
+    this->rotated.fetch_and(~rotated, std::memory_order_release);
+}
+void Logger::shiftGenerations(std::string const& base) noexcept
+{
+    uint32_t const gens = this->generations;
+    // Drop generations beyond current limit
+    for (uint32_t i = gens + 1;; ++i) {
+        std::string const old = base + "." + std::to_string(i);
+        if (RemoveFile(old) < 0) {
+            break;
+        }
+    }
+    // path.N-1 => path.N ... path.1 => path.2, rename replaces oldest
+    for (uint32_t i = gens - 1; i >= 1; --i) {
+        std::string const from = base + "." + std::to_string(i);
+        std::string const to = base + "." + std::to_string(i + 1);
+        if (::rename(from.c_str(), to.c_str()) < 0 && ENOENT != errno) {
+            std::cerr << "Logger::shiftGenerations: cannot rename " << from
+                << ": " << strerror(errno) << "\n";
+        }
+    }
+    std::string const rotating = base + kRotatingSuffix;
+    std::string const first = base + ".1";
+    if (::rename(rotating.c_str(), first.c_str()) < 0 && ENOENT != errno) {
+        std::cerr << "Logger::shiftGenerations: cannot rename " << rotating
+            << ": " << strerror(errno) << "\n";
+    }
 }
 //转成字符
 std::string logLevelToString(LogLevel const& logLevel) noexcept
 {
-    switch (logLevel) {
-#   define __CASE(c) case LogLevel::c: return #c "(" + \
-        std::to_string(uint32_t(logLevel)) + ")";
-    __CASE(Fata)
-    __CASE(Erro)
-    __CASE(Warn)
-    __CASE(Note)
-    __CASE(Info)
-    __CASE(Trac)
-    __CASE(Debu)
-    __CASE(Deta)
-#   undef __CASE
-    default: return "(unknown)(" + std::to_string(uint32_t(logLevel)) + ")";
+    if (uint32_t(logLevel) <= uint32_t(LogLevel::Max)) {
+        return std::string(kLevelTags[uint32_t(logLevel)], kLevelTagLen);
     }
+    return "(unknown)(" + std::to_string(uint32_t(logLevel)) + ")";
 }
 //时间
 std::string LogRealTime() noexcept
@@ -680,39 +2235,72 @@ std::string LogRealTime() noexcept
     if (::clock_gettime(CLOCK_REALTIME_COARSE, &tp)) {
         return "0000 00-00-00 00:00:00.000000000";
     }
-    struct tm localctm;
+    return LogRealTime(tp);
+}
+std::string LogRealTime(timespec const& tp) noexcept
+{
+    char buf[kLogRealTimeMaxLen];
+    return std::string(buf, FormatLogRealTime(tp, buf));
+}
+/// Rendered "tz YYYY-MM-DD HH:MM:SS." of last second seen by this thread
+struct RealTimePrefix {
+    time_t sec{ -1 };
+    uint32_t len{ 0 };
+    char data[kLogRealTimeMaxLen - 9];
+};
+static thread_local RealTimePrefix kRealTimePrefix;
+uint32_t FormatLogRealTime(timespec const& tp, char* const buf) noexcept
+{
+    auto& prefix = kRealTimePrefix;
+    if (prefix.sec != tp.tv_sec) {
+        // localtime_r takes tz lock, only once per second
+        struct tm localctm;
 #if !defined _WIN32 || !_WIN32
-    struct tm* const chk = ::localtime_r(&tp.tv_sec, &localctm);
-#else
-    struct tm* const chk = ::localtime(&tp.tv_sec);
-    if (!chk) {
-        ::memset(&localctm, chk, sizeof(struct tm));
-    }
-#endif
-    if (!chk) {
-        ::memset(&localctm, 0, sizeof(struct tm));
-    }
-    if (0 == localctm.tm_mday) {
-        localctm.tm_mday = 1;
-    }
-    //--
-    int const tz = int(int64_t(localctm.tm_gmtoff / 3600.0));
-    char buf[40];
-    ::snprintf(buf, sizeof(buf),"%02d %04d-%02d-%02d %02d:%02d:%02d.%09ld",
-        tz & 0xff,
-        localctm.tm_year + 1900,
-        localctm.tm_mon + 1,
-        localctm.tm_mday,
-        localctm.tm_hour,
-        localctm.tm_min,
-        localctm.tm_sec,
-#if !defined __APPLE__
-        tp.tv_nsec
+        struct tm* const chk = ::localtime_r(&tp.tv_sec, &localctm);
 #else
-        long(tp.tv_nsec)
+        struct tm* const chk = ::localtime(&tp.tv_sec);
+        if (!chk) {
+            ::memset(&localctm, chk, sizeof(struct tm));
+        }
 #endif
-    );
-    return buf;
+        if (!chk) {
+            ::memset(&localctm, 0, sizeof(struct tm));
+        }
+        if (0 == localctm.tm_mday) {
+            localctm.tm_mday = 1;
+        }
+        //--
+        int const tz = int(int64_t(localctm.tm_gmtoff / 3600.0));
+        int const n = ::snprintf(prefix.data, sizeof(prefix.data),
+            "%02d %04d-%02d-%02d %02d:%02d:%02d.",
+            tz & 0xff,
+            localctm.tm_year + 1900,
+            localctm.tm_mon + 1,
+            localctm.tm_mday,
+            localctm.tm_hour,
+            localctm.tm_min,
+            localctm.tm_sec);
+        if (n < 0) {
+            prefix.len = 0;
+        } else if (uint32_t(n) >= sizeof(prefix.data)) {
+            prefix.len = sizeof(prefix.data) - 1;
+        } else {
+            prefix.len = uint32_t(n);
+        }
+        prefix.sec = tp.tv_sec;
+    }
+    ::memcpy(buf, prefix.data, prefix.len);
+    // Nanoseconds, always 9 digits
+    char* const frac = buf + prefix.len;
+    uint32_t ns = uint32_t(tp.tv_nsec);
+    if (ns > 999999999) {
+        ns = 999999999;
+    }
+    // Leading 1 keeps zeros, dropped
+    char digits[10];
+    FormatU64(digits, 1000000000ull + ns);
+    ::memcpy(frac, digits + 1, 9);
+    return prefix.len + 9;
 }
 
 }//namespace log
@@ -0,0 +1,120 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+#include "ctilog/log/logstream.hpp"
+#include <string.h>
+#include <new>
+namespace cti {
+namespace log
+{
+LogStreamBuf::LogStreamBuf() noexcept
+{
+    this->setp(this->arena, this->arena + sizeof(this->arena));
+}
+void LogStreamBuf::reset() noexcept
+{
+    if (this->heap) {
+        this->setp(this->heap.get(), this->heap.get() + this->heapSize);
+    } else {
+        this->setp(this->arena, this->arena + sizeof(this->arena));
+    }
+}
+bool LogStreamBuf::grow(size_t const n) noexcept
+{
+    size_t const len = this->size();
+    size_t const cap = size_t(this->epptr() - this->pbase());
+    if (len + n <= cap) {
+        return true;
+    }
+    size_t size = cap * 2;
+    if (size < len + n) {
+        size = len + n;
+    }
+    std::unique_ptr<char[]> heap(new (std::nothrow) char[size]);
+    if (!heap) {
+        return false;
+    }
+    ::memcpy(heap.get(), this->pbase(), len);
+    this->heap = std::move(heap);
+    this->heapSize = size;
+    this->setp(this->heap.get(), this->heap.get() + size);
+    // pbump takes int, records are far below 2 GB
+    this->pbump(int(len));
+    return true;
+}
+void LogStreamBuf::append(char const* const s, size_t const n) noexcept
+{
+    if (size_t(this->epptr() - this->pptr()) < n && !this->grow(n)) {
+        return;
+    }
+    ::memcpy(this->pptr(), s, n);
+    this->pbump(int(n));
+}
+LogStreamBuf::int_type LogStreamBuf::overflow(int_type const c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+    if (!this->grow(1)) {
+        return traits_type::eof();
+    }
+    *this->pptr() = traits_type::to_char_type(c);
+    this->pbump(1);
+    return c;
+}
+std::streamsize LogStreamBuf::xsputn(char const* const s,
+    std::streamsize const n)
+{
+    if (n <= 0) {
+        return 0;
+    }
+    if (this->epptr() - this->pptr() < n && !this->grow(size_t(n))) {
+        return 0;
+    }
+    ::memcpy(this->pptr(), s, size_t(n));
+    this->pbump(int(n));
+    return n;
+}
+void LogStream::reset() noexcept
+{
+    this->buf.reset();
+    this->os.clear();
+    this->os.flags(std::ios_base::skipws | std::ios_base::dec);
+    this->os.precision(6);
+    this->os.width(0);
+    this->os.fill(' ');
+}
+LogStream& ThreadLogStream() noexcept
+{
+    static thread_local LogStream stream;
+    return stream;
+}
+ScopedLogStream::ScopedLogStream() noexcept
+{
+    LogStream& stream = ThreadLogStream();
+    if (stream.busy) {
+        this->nested.reset(new LogStream);
+        this->s = this->nested.get();
+    } else {
+        this->s = &stream;
+        this->s->reset();
+    }
+    this->s->busy = true;
+}
+ScopedLogStream::~ScopedLogStream() noexcept
+{
+    if (this->s) {
+        this->s->busy = false;
+    }
+}
+}//namespace log
+}//namespace cti
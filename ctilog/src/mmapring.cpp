@@ -0,0 +1,211 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+#include "ctilog/log/mmapring.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <tuple>
+#include "ctilog/log/file.hpp"
+namespace cti {
+namespace log
+{
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+    "head is a plain u64 in file");
+/// Ties len to the lap its frame was written in
+static inline uint32_t RingCheck(uint32_t const len, uint64_t const pos)
+    noexcept
+{
+    return len ^ uint32_t(pos) ^ uint32_t(pos >> 32) ^ 0x9e3779b9u;
+}
+static inline uint64_t RingFrameSize(uint64_t const len) noexcept
+{
+    return (kRingFrameHeadLen + len + kRingAlign - 1) &
+        ~uint64_t(kRingAlign - 1);
+}
+MmapRing::~MmapRing() noexcept
+{
+    this->close();
+}
+int MmapRing::open(std::string const& path, size_t const bytes) noexcept
+{
+    this->close();
+    uint64_t cap = std::min(std::max(bytes, kMinRingSize), kMaxRingSize);
+    cap &= ~uint64_t(kRingAlign - 1);
+    size_t const total = kRingHeaderSize + cap;
+    int const fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -errno;
+    }
+    // Continue a ring of same size, e.g. after a crash
+    bool reuse = false;
+    struct stat st;
+    if (!::fstat(fd, &st) && uint64_t(st.st_size) == total) {
+        char head[sizeof(kRingMagic) + sizeof(uint64_t)];
+        uint64_t c;
+        if (::pread(fd, head, sizeof(head), 0) == ssize_t(sizeof(head))) {
+            ::memcpy(&c, head + sizeof(kRingMagic), sizeof(c));
+            reuse = !::memcmp(head, kRingMagic, sizeof(kRingMagic)) &&
+                c == cap;
+        }
+    }
+    if (!reuse) {
+        // Zeroed, and blocks allocated so a full disk is not SIGBUS later
+        int ret = ::ftruncate(fd, 0) < 0 ? errno :
+            ::posix_fallocate(fd, 0, off_t(total));
+        if (EOPNOTSUPP == ret || EINVAL == ret) {
+            ret = ::ftruncate(fd, off_t(total)) < 0 ? errno : 0;
+        }
+        if (ret) {
+            ::close(fd);
+            return -ret;
+        }
+    }
+    void* const m = ::mmap(nullptr, total, PROT_READ | PROT_WRITE,
+        MAP_SHARED, fd, 0);
+    int const err = errno;
+    ::close(fd);
+    if (MAP_FAILED == m) {
+        return -err;
+    }
+    this->header = static_cast<Header*>(m);
+    if (!reuse) {
+        this->header->capacity = cap;
+        this->header->head.store(0, std::memory_order_relaxed);
+        ::memcpy(this->header->magic, kRingMagic, sizeof(kRingMagic));
+    }
+    this->data = static_cast<char*>(m) + kRingHeaderSize;
+    this->cap = cap;
+    this->mapped = total;
+    return 0;
+}
+void MmapRing::close() noexcept
+{
+    if (!this->header) {
+        return;
+    }
+    ::munmap(this->header, this->mapped);
+    this->header = nullptr;
+    this->data = nullptr;
+    this->cap = 0;
+    this->mapped = 0;
+}
+void MmapRing::append(char const* const msg, size_t len) noexcept
+{
+    if (!this->data) {
+        return;
+    }
+    len = std::min<uint64_t>(len, this->cap / 4);
+    uint64_t const pos = this->header->head.fetch_add(RingFrameSize(len),
+        std::memory_order_relaxed);
+    uint64_t const off = pos % this->cap;
+    char* const frame = this->data + off;
+    uint32_t const head[2] = { uint32_t(len), RingCheck(uint32_t(len), pos) };
+    ::memcpy(frame, head, sizeof(head));
+    // Frame header never wraps, msg may
+    size_t const first = std::min<uint64_t>(len,
+        this->cap - off - kRingFrameHeadLen);
+    ::memcpy(frame + kRingFrameHeadLen, msg, first);
+    ::memcpy(this->data, msg + first, len - first);
+    // Valid once pos matches, so stored last
+    reinterpret_cast<std::atomic<uint64_t>*>(frame + sizeof(head))->store(
+        pos, std::memory_order_release);
+}
+int MmapRing::sync() noexcept
+{
+    if (!this->header) {
+        return 0;
+    }
+    return ::msync(this->header, this->mapped, MS_SYNC) < 0 ? -errno : 0;
+}
+int64_t ReadRing(std::string const& path,
+    std::function<void(char const* const msg, size_t const len)> const& f)
+    noexcept
+{
+    File file(path);
+    int const ret = file.open(FileOpenConfig{ PosixFileAccessMode::ReadOnly });
+    if (ret < 0) {
+        return ret;
+    }
+    ssize_t const size = file.size();
+    if (size < 0) {
+        return size;
+    }
+    if (uint64_t(size) < kRingHeaderSize + kMinRingSize ||
+        uint64_t(size) > kRingHeaderSize + kMaxRingSize) {
+        return -EBADMSG;
+    }
+    int64_t n = -EBADMSG;
+    // Msg wrapped at end of data joined here
+    std::string joined;
+    auto const didRead = [&n, &joined, &f](uint8_t const* const p,
+        uint32_t const len) -> bool {
+        char const* const base = reinterpret_cast<char const*>(p);
+        uint64_t cap;
+        uint64_t head;
+        ::memcpy(&cap, base + sizeof(kRingMagic), sizeof(cap));
+        ::memcpy(&head, base + sizeof(kRingMagic) + sizeof(cap), sizeof(head));
+        if (::memcmp(base, kRingMagic, sizeof(kRingMagic)) ||
+            cap < kMinRingSize || cap % kRingAlign ||
+            kRingHeaderSize + cap != len) {
+            return false;
+        }
+        char const* const data = base + kRingHeaderSize;
+        // Oldest byte still in ring, frame boundary unknown after a wrap
+        uint64_t pos = head > cap ? head - cap : 0;
+        n = 0;
+        while (pos + kRingFrameHeadLen <= head) {
+            uint64_t const off = pos % cap;
+            uint32_t frameHead[2];
+            uint64_t framePos;
+            ::memcpy(frameHead, data + off, sizeof(frameHead));
+            ::memcpy(&framePos, data + off + sizeof(frameHead),
+                sizeof(framePos));
+            uint64_t const frameSize = RingFrameSize(frameHead[0]);
+            if (framePos != pos || frameHead[1] != RingCheck(frameHead[0], pos)
+                || pos + frameSize > head) {
+                // Not a frame start, or not finished
+                pos += kRingAlign;
+                continue;
+            }
+            size_t const msgLen = frameHead[0];
+            size_t const first = std::min<uint64_t>(msgLen,
+                cap - off - kRingFrameHeadLen);
+            try {
+                if (first == msgLen) {
+                    f(data + off + kRingFrameHeadLen, msgLen);
+                } else {
+                    joined.assign(data + off + kRingFrameHeadLen, first);
+                    joined.append(data, msgLen - first);
+                    f(joined.data(), msgLen);
+                }
+            } catch (...) {}
+            ++n;
+            pos += frameSize;
+        }
+        // Whole file in one call, true would only log a cancel
+        return false;
+    };
+    int32_t code;
+    uint64_t read;
+    std::tie(code, read) = file.traverse(didRead, uint64_t(size));
+    if (code < 0) {
+        return code;
+    }
+    return n;
+}
+}//namespace log
+}//namespace cti
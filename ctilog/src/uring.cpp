@@ -0,0 +1,367 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+#include "ctilog/log/uring.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <iostream>
+#include <new>
+#if defined __linux__ && defined __NR_io_uring_setup
+#include <linux/io_uring.h>
+#define CTILOG_HAS_URING 1
+#endif
+namespace cti {
+namespace log
+{
+/// pwrite all of @a len from @a offset, async-signal-safe, @return 0 or -errno
+static int PwriteAll(int const fd, char const* data, size_t len,
+    uint64_t offset) noexcept
+{
+    while (len) {
+        ssize_t const n = ::pwrite(fd, data, len, off_t(offset));
+        if (n < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return -errno;
+        }
+        data += n;
+        len -= size_t(n);
+        offset += uint64_t(n);
+    }
+    return 0;
+}
+UringWriter::~UringWriter() noexcept
+{
+    this->close();
+}
+#if defined CTILOG_HAS_URING
+static inline uint32_t LoadAcquire(uint32_t const* const p) noexcept
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+static inline void StoreRelease(uint32_t* const p, uint32_t const v) noexcept
+{
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+int UringWriter::open(uint32_t const buffers, uint32_t const bufferBytes)
+    noexcept
+{
+    this->close();
+    uint32_t const n = std::min(std::max(buffers, 2u), 64u);
+    io_uring_params p;
+    ::memset(&p, 0, sizeof(p));
+    int const ringFd = int(::syscall(__NR_io_uring_setup, n, &p));
+    if (ringFd < 0) {
+        return -errno;
+    }
+    this->ringFd = ringFd;
+    this->sqMapSize = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    this->cqMapSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool const single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) {
+        this->sqMapSize = this->cqMapSize =
+            std::max(this->sqMapSize, this->cqMapSize);
+    }
+    this->sqMap = ::mmap(nullptr, this->sqMapSize, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == this->sqMap) {
+        int const ret = -errno;
+        this->sqMap = nullptr;
+        this->close();
+        return ret;
+    }
+    if (single) {
+        this->cqMap = this->sqMap;
+    } else {
+        this->cqMap = ::mmap(nullptr, this->cqMapSize, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (MAP_FAILED == this->cqMap) {
+            int const ret = -errno;
+            this->cqMap = nullptr;
+            this->close();
+            return ret;
+        }
+    }
+    this->sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+    this->sqes = ::mmap(nullptr, this->sqesSize, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (MAP_FAILED == this->sqes) {
+        int const ret = -errno;
+        this->sqes = nullptr;
+        this->close();
+        return ret;
+    }
+    char* const sq = static_cast<char*>(this->sqMap);
+    char* const cq = static_cast<char*>(this->cqMap);
+    this->sqHead = reinterpret_cast<uint32_t*>(sq + p.sq_off.head);
+    this->sqTail = reinterpret_cast<uint32_t*>(sq + p.sq_off.tail);
+    this->sqMask = *reinterpret_cast<uint32_t*>(sq + p.sq_off.ring_mask);
+    this->sqArray = reinterpret_cast<uint32_t*>(sq + p.sq_off.array);
+    this->cqHead = reinterpret_cast<uint32_t*>(cq + p.cq_off.head);
+    this->cqTail = reinterpret_cast<uint32_t*>(cq + p.cq_off.tail);
+    this->cqMask = *reinterpret_cast<uint32_t*>(cq + p.cq_off.ring_mask);
+    this->cqes = cq + p.cq_off.cqes;
+    this->buffers.reset(new (std::nothrow) Buffer[n]);
+    if (!this->buffers) {
+        this->close();
+        return -ENOMEM;
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        this->buffers[i].data.reset(new (std::nothrow) char[bufferBytes]);
+        if (!this->buffers[i].data) {
+            this->close();
+            return -ENOMEM;
+        }
+    }
+    this->count = n;
+    this->bufferBytes = bufferBytes;
+    this->filling = n;
+    return 0;
+}
+void UringWriter::queue(uint32_t const i) noexcept
+{
+    Buffer& b = this->buffers[i];
+    b.iov.iov_base = b.data.get();
+    b.iov.iov_len = b.len;
+    uint32_t const tail = *this->sqTail;
+    uint32_t const idx = tail & this->sqMask;
+    io_uring_sqe* const sqes = static_cast<io_uring_sqe*>(this->sqes);
+    // Link previous one queued in this enter to this, so written in order
+    if (this->queued) {
+        sqes[(tail - 1) & this->sqMask].flags |= IOSQE_IO_LINK;
+    }
+    io_uring_sqe& sqe = sqes[idx];
+    ::memset(&sqe, 0, sizeof(sqe));
+    // WRITEV is in every kernel with io_uring (5.1), WRITE only since 5.6
+    sqe.opcode = IORING_OP_WRITEV;
+    sqe.fd = this->fd;
+    sqe.addr = uint64_t(uintptr_t(&b.iov));
+    sqe.len = 1;
+    sqe.off = b.offset;
+    sqe.user_data = i;
+    this->sqArray[idx] = idx;
+    StoreRelease(this->sqTail, tail + 1);
+    b.state = State::InFlight;
+    ++this->inFlight;
+    ++this->queued;
+}
+int UringWriter::enter(uint32_t const minComplete) noexcept
+{
+    uint32_t const flags = minComplete ? IORING_ENTER_GETEVENTS : 0;
+    while (this->queued || minComplete) {
+        int const ret = int(::syscall(__NR_io_uring_enter, this->ringFd,
+            this->queued, minComplete, flags, nullptr, 0));
+        if (ret < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return -errno;
+        }
+        this->queued -= std::min(this->queued, uint32_t(ret));
+        if (!this->queued) {
+            break;
+        }
+    }
+    this->reap();
+    return 0;
+}
+void UringWriter::reap() noexcept
+{
+    uint32_t head = *this->cqHead;
+    uint32_t const tail = LoadAcquire(this->cqTail);
+    io_uring_cqe const* const cqes = static_cast<io_uring_cqe const*>(this->cqes);
+    for (; head != tail; ++head) {
+        io_uring_cqe const& cqe = cqes[head & this->cqMask];
+        if (cqe.user_data >= this->count) {
+            continue;
+        }
+        Buffer& b = this->buffers[cqe.user_data];
+        // Short, failed or cancelled as a link before failed
+        uint32_t const done = cqe.res > 0 ? uint32_t(cqe.res) : 0;
+        if (done < b.len) {
+            int const ret = PwriteAll(this->fd, b.data.get() + done,
+                b.len - done, b.offset + done);
+            if (ret < 0 && !this->error) {
+                this->error = ret;
+                std::cerr << "UringWriter: write fail: " << ::strerror(-ret)
+                    << "\n";
+            }
+        }
+        b.len = 0;
+        b.state = State::Free;
+        --this->inFlight;
+    }
+    StoreRelease(this->cqHead, head);
+}
+#else
+int UringWriter::open(uint32_t const, uint32_t const) noexcept
+{
+    return -ENOSYS;
+}
+void UringWriter::queue(uint32_t const) noexcept {}
+int UringWriter::enter(uint32_t const) noexcept
+{
+    return -ENOSYS;
+}
+void UringWriter::reap() noexcept {}
+#endif
+void UringWriter::close() noexcept
+{
+    this->detach();
+    if (this->sqes) {
+        ::munmap(this->sqes, this->sqesSize);
+        this->sqes = nullptr;
+    }
+    if (this->cqMap && this->cqMap != this->sqMap) {
+        ::munmap(this->cqMap, this->cqMapSize);
+    }
+    this->cqMap = nullptr;
+    if (this->sqMap) {
+        ::munmap(this->sqMap, this->sqMapSize);
+        this->sqMap = nullptr;
+    }
+    if (this->ringFd >= 0) {
+        ::close(this->ringFd);
+        this->ringFd = -1;
+    }
+    this->buffers.reset();
+    this->count = 0;
+    this->filling = 0;
+}
+int UringWriter::attach(std::string const& path) noexcept
+{
+    this->detach();
+    if (this->ringFd < 0) {
+        return -ENOSYS;
+    }
+    // Not O_APPEND, each write has its offset
+    int const fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+    off_t const end = ::lseek(fd, 0, SEEK_END);
+    if (end < 0) {
+        int const ret = -errno;
+        ::close(fd);
+        return ret;
+    }
+    this->fd = fd;
+    this->offset = uint64_t(end);
+    this->error = 0;
+    return 0;
+}
+void UringWriter::detach() noexcept
+{
+    if (this->fd < 0) {
+        return;
+    }
+    this->drain();
+    ::close(this->fd);
+    this->fd = -1;
+}
+int UringWriter::nextBuffer() noexcept
+{
+    for (;;) {
+        for (uint32_t i = 0; i < this->count; ++i) {
+            if (State::Free == this->buffers[i].state) {
+                Buffer& b = this->buffers[i];
+                b.state = State::Filling;
+                b.len = 0;
+                b.offset = this->offset;
+                this->filling = i;
+                return 0;
+            }
+        }
+        // All in flight, wait one
+        int const ret = this->enter(1);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+}
+int UringWriter::write(char const* data, size_t len) noexcept
+{
+    if (this->fd < 0) {
+        return -EBADF;
+    }
+    while (len) {
+        if (this->filling >= this->count) {
+            int const ret = this->nextBuffer();
+            if (ret < 0) {
+                return ret;
+            }
+        }
+        Buffer& b = this->buffers[this->filling];
+        size_t const n = std::min(len, size_t(this->bufferBytes - b.len));
+        ::memcpy(b.data.get() + b.len, data, n);
+        b.len += uint32_t(n);
+        this->offset += n;
+        data += n;
+        len -= n;
+        if (b.len == this->bufferBytes) {
+            this->queue(this->filling);
+            this->filling = this->count;
+            int const ret = this->enter(0);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    }
+    return 0;
+}
+int UringWriter::submit() noexcept
+{
+    if (this->fd < 0) {
+        return 0;
+    }
+    if (this->filling < this->count) {
+        if (this->buffers[this->filling].len) {
+            this->queue(this->filling);
+        } else {
+            this->buffers[this->filling].state = State::Free;
+        }
+        this->filling = this->count;
+    }
+    return this->enter(0);
+}
+int UringWriter::drain() noexcept
+{
+    int ret = this->submit();
+    while (ret >= 0 && this->inFlight) {
+        ret = this->enter(1);
+    }
+    if (ret >= 0 && this->error) {
+        ret = this->error;
+        this->error = 0;
+    }
+    return ret;
+}
+void UringWriter::crashFlush() noexcept
+{
+    if (this->fd < 0) {
+        return;
+    }
+    for (uint32_t i = 0; i < this->count; ++i) {
+        Buffer const& b = this->buffers[i];
+        if (State::Free != b.state && b.len) {
+            PwriteAll(this->fd, b.data.get(), b.len, b.offset);
+        }
+    }
+}
+}//namespace log
+}//namespace cti
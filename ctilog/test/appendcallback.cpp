@@ -0,0 +1,60 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file test/appendcallback.cpp
+ * An AppendCallback logging again, nested deeper than the per thread line
+ * buffers, still sees its own line after the nested calls return
+ */
+#include <string>
+#include "ctilog/log.hpp"
+#include "test.hpp"
+using namespace cti::log;
+using namespace cti::log::test;
+/// Nesting of callbacks, deeper than buffers kept per thread
+constexpr int kDepth = 6;
+int main()
+{
+    std::string paths[kDepth];
+    Logger* loggers[kDepth];
+    for (int i = 0; i < kDepth; ++i) {
+        paths[i] = LogPath("ctilog-test-callback" + std::to_string(i));
+        loggers[i] = &Logger::getLogger(paths[i], Logger::Output::File);
+    }
+    int seen = 0;
+    for (int i = 0; i < kDepth; ++i) {
+        Logger* const next = i + 1 < kDepth ? loggers[i + 1] : nullptr;
+        std::string const name = "depth" + std::to_string(i);
+        loggers[i]->setAppendCallback([next, i, &seen](StringView const& name,
+            LogLevel const&, StringView const& msg) {
+            std::string const before(msg.data(), msg.size());
+            if (next) {
+                // Forward, renders a line of its own in this thread
+                next->n("depth" + std::to_string(i + 1),
+                    "forwarded from a longer outer line " + before);
+            }
+            CTILOG_CHECK(std::string(msg.data(), msg.size()) == before);
+            CTILOG_CHECK(before.find("[" + std::string(name.data(),
+                name.size()) + "]") != std::string::npos);
+            ++seen;
+        });
+        loggers[i]->addAcNameFilter(name);
+    }
+    loggers[0]->n("depth0", "record");
+    CTILOG_CHECK(kDepth == seen);
+    for (int i = 0; i < kDepth; ++i) {
+        loggers[i]->setAppendCallback(nullptr);
+        loggers[i]->finish();
+        Logger::releaseLogger(paths[i]);
+    }
+    return kFailures;
+}
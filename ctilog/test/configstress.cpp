@@ -0,0 +1,93 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file test/configstress.cpp
+ * Logging threads race a thread changing level, flush policy, outputs,
+ * idx/tid and append callback; built with -fsanitize=thread, a race found
+ * fails the test by ThreadSanitizer exit code
+ */
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ctilog/log.hpp"
+#include "ctilog/loghelper.cpp.hpp"
+#include "test.hpp"
+constexpr char const* kN = "stress";
+using namespace cti::log;
+using namespace cti::log::test;
+constexpr int kLoggingThreads = 4;
+constexpr int kRecordsPerThread = 20000;
+int main()
+{
+    std::string const path = LogPath("ctilog-test-configstress");
+    auto& logger = Logger::getLogger(path, Logger::Output::File);
+    Logger::setDefaultLogger(path);
+    logger.setMaxSize(1 << 30);
+    std::atomic<int> running{ kLoggingThreads };
+    std::atomic<uint64_t> called{ 0 };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kLoggingThreads; ++t) {
+        threads.emplace_back([&logger, &running, t]() {
+            for (int i = 0; i < kRecordsPerThread; ++i) {
+                switch (i % 4) {
+                case 0: Note("thread " << t << " i " << i); break;
+                case 1: LogFmt(Info, "thread {} i {}", t, i); break;
+                case 2: Debug("thread " << t << " i " << i); break;
+                default: logger.n("stress", "plain"); break;
+                }
+                if (logger.getLogLevel() > LogLevel::Max) {
+                    CTILOG_CHECK(!"level out of range");
+                }
+            }
+            running.fetch_sub(1);
+        });
+    }
+    uint32_t round = 0;
+    while (running.load()) {
+        ++round;
+        logger.setLogLevel(round & 1 ? LogLevel::Debu : LogLevel::Note);
+        logger.toggleLogLevel();
+        Logger::FlushPolicy policy;
+        policy.bytes = round & 2 ? 0 : kDefaultFlushBytes;
+        policy.maxAgeMs = round & 4 ? 0 : kDefaultFlushAgeMs;
+        logger.setFlushPolicy(policy);
+        logger.setOutputs(round & 8 ? Logger::Outputs{} :
+            Logger::Outputs{ Logger::Output::File });
+        logger.enableIdx(round & 16);
+        logger.enableTid(round & 32);
+        if (round & 64) {
+            logger.setAppendCallback([&called](StringView const&,
+                LogLevel const&, StringView const&) { called.fetch_add(1); });
+            logger.addAcNameFilter("stress");
+        } else {
+            logger.setAppendCallback(nullptr);
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    // Last set wins
+    logger.setLogLevel(LogLevel::Warn);
+    CTILOG_CHECK(LogLevel::Warn == logger.getLogLevel());
+    logger.setOutputs(Logger::Output::File);
+    logger.setAppendCallback(nullptr);
+    logger.finish();
+    Logger::releaseLogger(path);
+    ::printf("%u config rounds, %llu callbacks\n", round,
+        (unsigned long long)called.load());
+    CTILOG_CHECK(round > 1);
+    return kFailures;
+}
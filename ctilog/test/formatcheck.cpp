@@ -0,0 +1,108 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file test/formatcheck.cpp
+ * Compile time "{}" count of LogFmt/LogBin literals: a literal longer than
+ * the default constexpr depth compiles, and the halving scan counts as a
+ * plain left to right scan for every short string of braces. Logger::info
+ * etc. take a literal or an explicit RuntimeFormat, not any char const*.
+ */
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include "ctilog/log.hpp"
+#include "ctilog/loghelper.cpp.hpp"
+#include "test.hpp"
+constexpr char const* kN = "format";
+using namespace cti::log;
+using namespace cti::log::test;
+#define CTILOG_TEST_X10(s) s s s s s s s s s s
+/// 6000 chars, escaped braces across every halving point
+#define CTILOG_TEST_LONG CTILOG_TEST_X10(CTILOG_TEST_X10(CTILOG_TEST_X10( \
+    "ab{{}}")))
+static_assert(2 == FormatArgCount(CTILOG_TEST_LONG " {} {}"), "long");
+static_assert(0 == FormatArgCount(""), "empty");
+static_assert(1 == FormatArgCount("{{{}}}"), "escaped around arg");
+static_assert(-1 == FormatArgCount("{{{"), "open brace at end");
+static_assert(-1 == FormatArgCount("a}b"), "single close brace");
+static_assert(-1 == FormatArgCount("{a}"), "brace around text");
+static_assert(!std::is_convertible<char const*, FormatString<1>>::value,
+    "runtime format only by RuntimeFormat");
+/// Count as before halving: one char or pair at a time, -1 when unpaired
+static int ScanCount(char const* f)
+{
+    int n = 0;
+    while (*f) {
+        if (('{' == f[0] || '}' == f[0]) && f[0] == f[1]) {
+            f += 2;
+        } else if ('{' == f[0] && '}' == f[1]) {
+            f += 2;
+            ++n;
+        } else if ('{' == f[0] || '}' == f[0]) {
+            return -1;
+        } else {
+            ++f;
+        }
+    }
+    return n;
+}
+/// Longest string of kChars checked, all of them
+constexpr int kMaxLen = 9;
+constexpr char kChars[] = "{}a";
+int main()
+{
+    int strings = 0;
+    for (int len = 0; len <= kMaxLen; ++len) {
+        int total = 1;
+        for (int i = 0; i < len; ++i) {
+            total *= 3;
+        }
+        for (int k = 0; k < total; ++k) {
+            char f[kMaxLen + 1];
+            for (int i = 0, v = k; i < len; ++i, v /= 3) {
+                f[i] = kChars[v % 3];
+            }
+            f[len] = '\0';
+            int const got = FormatScanCount(FormatScan(f, 0, size_t(len), 0));
+            if (got != ScanCount(f)) {
+                ::fprintf(stderr, "\"%s\": %d\n", f, got);
+                CTILOG_CHECK(got == ScanCount(f));
+            }
+            ++strings;
+        }
+    }
+    ::printf("%d strings scanned\n", strings);
+    std::string const path = LogPath("ctilog-test-format");
+    auto& logger = Logger::getLogger(path, Logger::Output::File);
+    Logger::setDefaultLogger(path);
+    LogFmt(Warn, CTILOG_TEST_LONG " {} {}", 1, "two");
+    logger.warn("method", "literal {} {}", 3, 4.5);
+    std::string const made = std::string("runtime") + " {}";
+    logger.warn("method", RuntimeFormat(made.c_str()), 6);
+    logger.finish();
+    std::ifstream in(path);
+    std::stringstream text;
+    text << in.rdbuf();
+    std::string expect;
+    for (int i = 0; i < 1000; ++i) {
+        expect += "ab{}";
+    }
+    expect += " 1 two";
+    CTILOG_CHECK(text.str().find(expect) != std::string::npos);
+    CTILOG_CHECK(text.str().find("literal 3 4.5") != std::string::npos);
+    CTILOG_CHECK(text.str().find("runtime 6") != std::string::npos);
+    Logger::releaseLogger(path);
+    return kFailures;
+}
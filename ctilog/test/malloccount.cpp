@@ -0,0 +1,115 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file test/malloccount.cpp
+ * Steady state logging does no malloc: after a warm up growing the per
+ * thread buffers, records of each append path are counted
+ *
+ * malloc is interposed in this executable and forwarded to glibc, counted
+ * per thread, so the age flusher thread is not counted
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "ctilog/log.hpp"
+#include "ctilog/loghelper.cpp.hpp"
+#include "test.hpp"
+#if defined __GLIBC__
+static __thread uint64_t kMallocs = 0;
+static __thread bool kCounting = false;
+extern "C" {
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* p, size_t size);
+void* malloc(size_t const size)
+{
+    kMallocs += kCounting;
+    return __libc_malloc(size);
+}
+void* calloc(size_t const n, size_t const size)
+{
+    kMallocs += kCounting;
+    return __libc_calloc(n, size);
+}
+void* realloc(void* const p, size_t const size)
+{
+    kMallocs += kCounting;
+    return __libc_realloc(p, size);
+}
+}//extern "C"
+#endif
+constexpr char const* kN = "malloc";
+using namespace cti::log;
+using namespace cti::log::test;
+/// Records of each path counted
+constexpr int kRecords = 10000;
+/// Mallocs by @a f called kRecords times, after as many to warm up
+template<typename F>
+static uint64_t CountMallocs(F&& f)
+{
+#if defined __GLIBC__
+    for (int i = 0; i < kRecords; ++i) {
+        f(i);
+    }
+    kMallocs = 0;
+    kCounting = true;
+    for (int i = 0; i < kRecords; ++i) {
+        f(i);
+    }
+    kCounting = false;
+    return kMallocs;
+#else
+    (void)f;
+    return 0;
+#endif
+}
+int main()
+{
+#if !defined __GLIBC__
+    ::printf("skip: malloc interposing needs glibc\n");
+    return kSkip;
+#endif
+    std::string const path = LogPath("ctilog-test-malloc");
+    auto& logger = Logger::getLogger(path, Logger::Output::File);
+    Logger::setDefaultLogger(path);
+    logger.setLogLevel(LogLevel::Info);
+    // Rotation renames and opens, not steady state
+    logger.setMaxSize(1 << 30);
+    uint64_t n;
+    n = CountMallocs([&logger](int) {
+        logger.n("name", "a message of moderate length 1234567890"); });
+    ::printf("Logger::n(name, msg): %llu mallocs\n", (unsigned long long)n);
+    CTILOG_CHECK(0 == n);
+    n = CountMallocs([&logger](int) {
+        logger.append("a message of moderate length", LogLevel::Note); });
+    ::printf("Logger::append(msg, level): %llu mallocs\n",
+        (unsigned long long)n);
+    CTILOG_CHECK(0 == n);
+    n = CountMallocs([](int const i) { Note("streamed " << i << ' ' << 1.5); });
+    ::printf("Note(stream): %llu mallocs\n", (unsigned long long)n);
+    CTILOG_CHECK(0 == n);
+    n = CountMallocs([](int const i) { LogFmt(Note, "format {} {}", i, 1.5); });
+    ::printf("LogFmt: %llu mallocs\n", (unsigned long long)n);
+    CTILOG_CHECK(0 == n);
+    n = CountMallocs([](int const i) {
+        LogBin(Note, "binary off {} {}", i, 1.5); });
+    ::printf("LogBin, rendered as text: %llu mallocs\n",
+        (unsigned long long)n);
+    CTILOG_CHECK(0 == n);
+    n = CountMallocs([](int const i) { Debug("filtered " << i); });
+    ::printf("Debug below level: %llu mallocs\n", (unsigned long long)n);
+    CTILOG_CHECK(0 == n);
+    logger.finish();
+    Logger::releaseLogger(path);
+    return kFailures;
+}
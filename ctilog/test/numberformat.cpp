@@ -0,0 +1,163 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file test/numberformat.cpp
+ * Number formatting kernels: FormatDouble/FormatFloat read back by
+ * strtod/strtof to the same bits, for random bit patterns and edge values;
+ * FormatU64/FormatI64 equal to snprintf around each digit count boundary
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits>
+#include <random>
+#include <string>
+#include "ctilog/log/format.hpp"
+#include "test.hpp"
+using namespace cti::log;
+using namespace cti::log::test;
+/// Random bit patterns of each type
+constexpr int kRandom = 1000000;
+/// Failures printed, the rest only counted
+constexpr int kPrinted = 10;
+static int kMismatches = 0;
+static void CheckDouble(double const v)
+{
+    char buf[kFormatFloatMaxLen + 1];
+    size_t const n = FormatDouble(buf, v);
+    buf[n] = '\0';
+    bool ok = n <= kFormatFloatMaxLen;
+    if (ok && isnan(v)) {
+        ok = !strcmp(buf, "nan");
+    } else if (ok) {
+        double const back = ::strtod(buf, nullptr);
+        ok = !memcmp(&back, &v, sizeof(v));
+    }
+    if (!ok && kMismatches++ < kPrinted) {
+        ::fprintf(stderr, "FormatDouble(%.17g) = \"%s\"\n", v, buf);
+    }
+}
+static void CheckFloat(float const v)
+{
+    char buf[kFormatFloatMaxLen + 1];
+    size_t const n = FormatFloat(buf, v);
+    buf[n] = '\0';
+    bool ok = n <= kFormatFloatMaxLen;
+    if (ok && isnan(v)) {
+        ok = !strcmp(buf, "nan");
+    } else if (ok) {
+        float const back = ::strtof(buf, nullptr);
+        ok = !memcmp(&back, &v, sizeof(v));
+    }
+    if (!ok && kMismatches++ < kPrinted) {
+        ::fprintf(stderr, "FormatFloat(%.9g) = \"%s\"\n", double(v), buf);
+    }
+}
+static void CheckU64(uint64_t const v)
+{
+    char buf[kFormatIntMaxLen];
+    char expect[32];
+    int const len = ::snprintf(expect, sizeof(expect), "%llu",
+        static_cast<unsigned long long>(v));
+    size_t const n = FormatU64(buf, v);
+    if ((n != size_t(len) || memcmp(buf, expect, n)) &&
+        kMismatches++ < kPrinted) {
+        ::fprintf(stderr, "FormatU64(%s) = \"%.*s\"\n", expect, int(n), buf);
+    }
+}
+static void CheckI64(int64_t const v)
+{
+    char buf[kFormatIntMaxLen];
+    char expect[32];
+    int const len = ::snprintf(expect, sizeof(expect), "%lld",
+        static_cast<long long>(v));
+    size_t const n = FormatI64(buf, v);
+    if ((n != size_t(len) || memcmp(buf, expect, n)) &&
+        kMismatches++ < kPrinted) {
+        ::fprintf(stderr, "FormatI64(%s) = \"%.*s\"\n", expect, int(n), buf);
+    }
+}
+int main()
+{
+    // Digit count boundaries: 10^k - 1, 10^k, 10^k + 1 and powers of two
+    uint64_t p = 1;
+    for (int k = 0; k < 20; ++k, p *= 10) {
+        for (uint64_t const v: { p - 1, p, p + 1 }) {
+            CheckU64(v);
+            CheckI64(int64_t(v));
+            CheckI64(-int64_t(v));
+        }
+    }
+    for (int k = 0; k < 64; ++k) {
+        CheckU64(uint64_t(1) << k);
+        CheckU64((uint64_t(1) << k) - 1);
+    }
+    CheckU64(std::numeric_limits<uint64_t>::max());
+    CheckI64(std::numeric_limits<int64_t>::max());
+    CheckI64(std::numeric_limits<int64_t>::min());
+    // Edge values
+    double const kDoubles[] = { 0.0, -0.0, 1.0, -1.0, 0.1, 0.2, 0.3, 1.5,
+        1e23, 5e-324, -5e-324, 2.2250738585072009e-308, 2.2250738585072014e-308,
+        1.7976931348623157e308, -1.7976931348623157e308, 9007199254740991.0,
+        9007199254740992.0, 9007199254740993.0, 0.0001, 0.00009999999999999999,
+        123456789012345680.0, 4.35, 2.675, 1.005,
+        std::numeric_limits<double>::infinity(),
+        -std::numeric_limits<double>::infinity(),
+        std::numeric_limits<double>::quiet_NaN() };
+    for (double const v: kDoubles) {
+        CheckDouble(v);
+    }
+    for (int k = -325; k <= 308; ++k) {
+        double const v = ::strtod(("1e" + std::to_string(k)).c_str(),
+            nullptr);
+        CheckDouble(v);
+        CheckDouble(nextafter(v, 0.0));
+        CheckDouble(nextafter(v, HUGE_VAL));
+    }
+    for (int k = -1074; k <= 1023; ++k) {
+        CheckDouble(ldexp(1.0, k));
+    }
+    float const kFloats[] = { 0.0f, -0.0f, 0.1f, 1.0f / 3, 1.5f, 1e-45f,
+        -1e-45f, 1.17549435e-38f, 3.40282347e38f, 16777215.0f, 16777216.0f,
+        16777217.0f, std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::quiet_NaN() };
+    for (float const v: kFloats) {
+        CheckFloat(v);
+    }
+    for (int k = -46; k <= 38; ++k) {
+        float const v = ::strtof(("1e" + std::to_string(k)).c_str(), nullptr);
+        CheckFloat(v);
+        CheckFloat(nextafterf(v, 0.0f));
+        CheckFloat(nextafterf(v, HUGE_VALF));
+    }
+    // Random bit patterns, fixed seed so a failure repeats
+    std::mt19937_64 random(20260115);
+    for (int i = 0; i < kRandom; ++i) {
+        uint64_t const bits = random();
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        CheckDouble(d);
+        uint32_t const bits32 = uint32_t(bits >> 32);
+        float f;
+        memcpy(&f, &bits32, sizeof(f));
+        CheckFloat(f);
+        CheckU64(bits >> (bits & 63));
+        CheckI64(int64_t(bits) >> (bits & 63));
+    }
+    ::printf("%d mismatches\n", kMismatches);
+    CTILOG_CHECK(0 == kMismatches);
+    return kFailures;
+}
@@ -0,0 +1,48 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file test/test.hpp
+ * Checks of the test executables run by ctest, each main returns failures
+ */
+#pragma once
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+namespace cti {
+namespace log
+{
+namespace test
+{
+/// ctest SKIP_RETURN_CODE, when a test cannot run on this platform
+constexpr int kSkip = 77;
+static int kFailures = 0;
+/// Log file @a name in working directory (build dir), removed first
+inline std::string LogPath(std::string const& name)
+{
+    char cwd[4096];
+    std::string const path = std::string(::getcwd(cwd, sizeof(cwd)) ? cwd :
+        ".") + "/" + name + ".log";
+    ::unlink(path.c_str());
+    return path;
+}
+}//namespace test
+}//namespace log
+}//namespace cti
+/// Count and print a failed @a cond, go on
+#define CTILOG_CHECK(cond) { \
+    if (!(cond)) { \
+        ++cti::log::test::kFailures; \
+        ::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+            #cond); \
+    } \
+}
@@ -0,0 +1,86 @@
+/* This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+/**
+ * @file tools/decode.cpp
+ * ctilog-decode: render binary logs (*.log.bin) to text
+ *
+ * Usage: ctilog-decode [-t] [file.bin ...], stdin when no file, -t to
+ * output thread id; ctilog-decode -r file.ring ... to output ring files
+ * oldest first
+ */
+#include <string.h>
+#include <fstream>
+#include <iostream>
+#include "ctilog/log/binary.hpp"
+#include "ctilog/log/mmapring.hpp"
+int main(int argc, char* argv[])
+{
+    bool hasTid = false;
+    int first = 1;
+    if (argc > 1 && 0 == ::strcmp(argv[1], "-t")) {
+        hasTid = true;
+        first = 2;
+    }
+    if (argc > 1 && (0 == ::strcmp(argv[1], "-h") ||
+        0 == ::strcmp(argv[1], "--help"))) {
+        std::cout << "Usage: " << argv[0] << " [-t] [file.bin ...]\n"
+            "       " << argv[0] << " -r file.ring ...\n"
+            "Render ctilog binary logs to text, read stdin when no file\n"
+            "  -t  output thread id\n"
+            "  -r  output ring files (*.log.ring) oldest first\n";
+        return 0;
+    }
+    std::ios::sync_with_stdio(false);
+    if (argc > 1 && 0 == ::strcmp(argv[1], "-r")) {
+        int code = 0;
+        for (int i = 2; i < argc; ++i) {
+            int64_t const ret = cti::log::ReadRing(argv[i],
+                [](char const* const msg, size_t const len) {
+                    std::cout.write(msg, std::streamsize(len));
+                });
+            if (ret < 0) {
+                std::cerr << "ctilog-decode: " << argv[i] << ": "
+                    << ::strerror(int(-ret)) << "\n";
+                code = 1;
+            }
+        }
+        return code;
+    }
+    if (first >= argc) {
+        int64_t const ret = cti::log::DecodeBinaryLog(std::cin, std::cout,
+            hasTid);
+        if (ret < 0) {
+            std::cerr << "ctilog-decode: <stdin>: " << ::strerror(int(-ret))
+                << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    int code = 0;
+    for (int i = first; i < argc; ++i) {
+        std::ifstream in(argv[i], std::ios::binary);
+        if (!in) {
+            std::cerr << "ctilog-decode: cannot open " << argv[i] << "\n";
+            code = 1;
+            continue;
+        }
+        int64_t const ret = cti::log::DecodeBinaryLog(in, std::cout, hasTid);
+        if (ret < 0) {
+            // Records before a cut tail are already output
+            std::cerr << "ctilog-decode: " << argv[i] << ": "
+                << ::strerror(int(-ret)) << "\n";
+            code = 1;
+        }
+    }
+    return code;
+}